@@ -4,8 +4,9 @@
 
 // Provides driver functions for ADC
 // sampling to collect data for IR sensors.
-// Currently set up for channels 14, 16, and
-// 17 to get raw data as requested by software.
+// The channels sampled are given by a table
+// of channel descriptions, so sensors can be
+// added without changing the driver.
 
 
 /* This example accompanies the book
@@ -46,79 +47,390 @@ policies, either expressed or implied, of the FreeBSD Project.
 #include <stdint.h>
 #include "msp.h"
 #include "RCR_ADC14.h"
+#include "RCR_TimerA1.h"
+
+
+static const adc_chnl_desc* ADC_Chnls;      // channel table in ADC14MEM order
+static uint32_t ADC_Num_Chnls;
+static uint32_t* ADC_Samples;               // caller's array filled at end of sequence
+
+static void (*ADC14Task)(void);             // user task called at end of sequence
+static void (*ADC14DMATask)(uint32_t*);     // user task called with full DMA buffer
+static void (*ADC14WindowTask)(uint32_t);   // user task called when sample is above threshold
+static uint16_t Window_Thresh[ADC_MAX_CHNLS];   // thresholds in ADC14MEM order
+
+// DMA control table for all 8 channels, primary structures then
+// alternates, 4 words each(src end, dst end, control, unused).
+// The DMA needs it aligned to its size.
+static uint32_t DMA_ControlTable[64] __attribute__((aligned(256)));
+static uint32_t ADC_PingPong[2][ADC_MAX_CHNLS];     //buffers filled by DMA
+static uint32_t DMA_Control_Word;                   //reloaded after each buffer
+
+#define DMA_CH7_PRI 28      //word offset of channel 7 primary structure
+#define DMA_CH7_ALT 60      //word offset of channel 7 alternate structure
+
 
 /*
- Hardware connections
- ---------------------------------------------------------
- P9.0 = analog channel 17, right sensor
- P6.1 = analog channel 14, center sensor
- P9.1 = analog channel 16, left sensor
-*/
+  ADC_Pin_Init
+  ----------------------------------------------------------------------
+  Set a pin to its analog function. Only ports with analog inputs
+  are handled(P4, P5, P6, P8, P9).
 
+  Parameters:   1) port of the pin
+                2) pin number
+  Return value: none
+*/
+static void ADC_Pin_Init(uint8_t port, uint8_t pin) {
+    uint8_t mask = 1 << pin;
+    switch(port) {
+        case 4: P4->SEL0 |= mask; P4->SEL1 |= mask; break;
+        case 5: P5->SEL0 |= mask; P5->SEL1 |= mask; break;
+        case 6: P6->SEL0 |= mask; P6->SEL1 |= mask; break;
+        case 8: P8->SEL0 |= mask; P8->SEL1 |= mask; break;
+        case 9: P9->SEL0 |= mask; P9->SEL1 |= mask; break;
+        default: break;
+    }
+}
 
 
 /*
-  ADC0_Init_Ch17_14_16
+  ADC_Seq_Init
   ----------------------------------------------------------------------
-  Initialize 14-bit ADC0 in software-triggered mode to take measurements
-  when the associated function is called. The sequence of measurements
-  starts at channel 14, then channel 17, and ends at channel 16. Interrupts
-  are disabled and Timer1A is used to time the samples. The 12 MHz SMCLK
-  is used and sampling is set to 96 cycles and converting takes 16 cycles.
-  The 3.3V analog supply is used as reference.
+  Shared setup for every mode. Sets up the pins in the table, disables
+  the ADC14, and loads ADC14MEM0 onward with num_seqs copies of the table,
+  with the last one marked as the end of the sequence. The ADC14 is left
+  disabled with all interrupts off so each mode can finish setting it up.
 
-  Parameters:   none
+  Parameters:   1) table of channels to sample
+                2) number of channels in table
+                3) copies of the table to put in the sequence
+                4) ADC14CTL0 value without sampling times
   Return value: none
 */
-void ADC0_Init_Ch17_14_16(void) {
-    P6->SEL0 |= 0x02;                   //P6.1 analog function
-    P6->SEL1 |= 0x02;
-    P9->SEL0 |= 0x03;                   //P9.0,9.1 analog function
-    P9->SEL1 |= 0x03;
+static void ADC_Seq_Init(const adc_chnl_desc* chnls, uint32_t num_chnls, uint32_t num_seqs, uint32_t ctl0) {
+    uint32_t i, sht = 0;
+    ADC_Chnls     = chnls;
+    ADC_Num_Chnls = num_chnls;
+
+    for(i = 0; i < num_chnls; i++)
+    {
+        ADC_Pin_Init(chnls[i].port,chnls[i].pin);
+        if(chnls[i].sample_time > sht) sht = chnls[i].sample_time;  //longest sample time covers all channels
+    }
 
     ADC14->CTL0 &= ~0x00000002;         //disable ADC14 and wait for it to be available
     while(ADC14->CTL0 & 0x00010000) {}
-    // smclk_12MHz, divide by 1, sw trigger for sample, sequence of channels, 96 cycle sampling period, 1 trigger for all channels
-    ADC14->CTL0    = 0x04225590;
+    ADC14->CTL0    = ctl0 | (sht << 12) | (sht << 8);
     // start with ADC14MEM0, 14-bit resolution, binary unsigned, reference always on, regular power mode
     ADC14->CTL1    = 0x00000030;
-    // no comparator, single-ended mode, 3.3V reference
-    ADC14->MCTL[0] = 0x0000000E;        //not end of sequence, channel 14
-    ADC14->MCTL[1] = 0x00000011;        //not end of sequence, channel 17
-    ADC14->MCTL[2] = 0x00000090;        //end of sequence, channel 16
-    ADC14->IER0    = 0x00000000;        //all ADC interrupts disabled, will use timer instead
+    for(i = 0; i < num_chnls*num_seqs; i++)     //no comparator, single-ended mode, 3.3V reference
+    {
+        ADC14->MCTL[i] = chnls[i%num_chnls].anlg_chnl;
+    }
+    ADC14->MCTL[num_chnls*num_seqs-1] |= 0x00000080;    //end of sequence
+    ADC14->IER0    = 0x00000000;        //all ADC interrupts disabled
     ADC14->IER1    = 0x00000000;
+}
+
+
+/*
+  ADC0_Init
+  ----------------------------------------------------------------------
+  Initialize 14-bit ADC0 in software-triggered mode to take measurements
+  when ADC_In is called. The sequence of measurements follows the order
+  of the channel table, and the pins in the table are set to their analog
+  function. Interrupts are disabled and Timer1A is used to time the samples.
+  The 12 MHz SMCLK is used and converting takes 16 cycles. The ADC14 only
+  has 2 sampling times shared by all of its MEM registers, so the longest
+  sample_time in the table is used for every channel. The 3.3V analog
+  supply is used as reference.
+
+  Parameters:   1) table of channels to sample, must stay valid after init
+                2) number of channels in table,
+                       max is ADC_MAX_CHNLS
+  Return value: none
+*/
+void ADC0_Init(const adc_chnl_desc* chnls, uint32_t num_chnls) {
+    if(num_chnls > ADC_MAX_CHNLS) num_chnls = ADC_MAX_CHNLS;
+    // smclk_12MHz, divide by 1, sw trigger for sample, sequence of channels, 1 trigger for all channels
+    ADC_Seq_Init(chnls,num_chnls,1,0x04220090);
     ADC14->CTL0   |= 0x00000002;        //enable ADC14
 }
 
 
 /*
-  ADC_In17_14_16
+  ADC_In
   ----------------------------------------------------------------------
-  Trigger a single ADC measurement on A17, A14, and
-  A16 each, wait for them to complete, and put the results in
-  the pointers given. The pointers are 32-bit integers
-  because the ADC registers are 32 bits. In this case, bits
-  31-16 are undefined and bits 15-14 are zero.
+  Trigger a single ADC measurement on every channel in the table, wait
+  for them to complete, and put each result in the sample array at its
+  index from the table. The results are 32-bit integers because the ADC
+  registers are 32 bits. In this case, bits 31-16 are undefined and
+  bits 15-14 are zero.
   Busy-wait synchronization used, ADC input voltage range is
-  0 to 3.3V, and assumes ADC0_Init_Ch17_14_16() has been called
+  0 to 3.3V, and assumes ADC0_Init or ADC0_InitTask has been called
   and ADC is 14-bit precision.
 
-  Parameters:   1) address to store ch 17/right sample
-                2) address to store ch 14/center sample
-                3) address to store ch 16/left sample
+  Parameters:   1) array to store samples in, indexed by the table index
   Return value: none
 */
-void ADC_In17_14_16(uint32_t* ch17, uint32_t* ch14, uint32_t* ch16) {
+void ADC_In(uint32_t* samples) {
+    uint32_t i;
     while(ADC14->CTL0 & 0x00010000) {}      //wait for ADC14 to be free
     ADC14->CTL0 |= 0x00000001;              //start sequence of samples
-    //I may switch to ADC interrupt instead of this busy wait if I need a tiny performance boost(~28 us)
     while(ADC14->CTL0 & 0x00010000) {}      //wait for ADC14 to be free after all channels finish
-    *ch14 = ADC14->MEM[0];                  //read data from ADC14 channels
-    *ch17 = ADC14->MEM[1];
-    *ch16 = ADC14->MEM[2];
+    for(i = 0; i < ADC_Num_Chnls; i++)      //read data from ADC14 channels
+    {
+        samples[ADC_Chnls[i].index] = ADC14->MEM[i];
+    }
+}
+
+
+/*
+  ADC0_InitTask
+  ----------------------------------------------------------------------
+  Initialize ADC0 the same way as ADC0_Init, but arm the ADC14 interrupt
+  for the end of the sequence(last channel in table) so the samples are
+  handed to a user task instead of busy-waiting for them. Sequences are
+  started with ADC_Start, usually from the Timer A1 task. Once all
+  conversions finish, the sample array is filled the same way as ADC_In
+  and the user task is called.
+
+  The interrupt has a priority of 1, the same as Timer A1, so the bump
+  switches can still preempt it. ADC_In can still be used, but only
+  before interrupts are enabled(ex. to get the first filter samples).
+
+  Parameters:   1) table of channels to sample, must stay valid after init
+                2) number of channels in table,
+                       max is ADC_MAX_CHNLS
+                3) array filled with samples before user task is called,
+                       indexed by the table index
+                4) function pointer to user task called at end of sequence
+  Return value: none
+*/
+void ADC0_InitTask(const adc_chnl_desc* chnls, uint32_t num_chnls, uint32_t* samples, void(*task)(void)) {
+    ADC14Task   = task;
+    ADC_Samples = samples;
+    ADC0_Init(chnls,num_chnls);
+
+    ADC14->CTL0    &= ~0x00000002;                  //disable ADC14 to change interrupts
+    ADC14->CLRIFGR0 = 1 << (ADC_Num_Chnls-1);       //clear any old end of sequence flag
+    ADC14->IER0     = 1 << (ADC_Num_Chnls-1);       //interrupt on last ADC14MEM in sequence
+    ADC14->CTL0    |= 0x00000002;
+
+    NVIC->IP[24]   = 0x20;              //priority 1, same as sample timer
+    NVIC->ISER[0] |= 0x01000000;        //enable ADC14(irq 24) interrupt
+}
+
+
+/*
+  ADC_Start
+  ----------------------------------------------------------------------
+  Trigger a single ADC measurement on every channel in the table and
+  return without waiting. The results are given to the user task from
+  ADC0_InitTask when the sequence is done. If the last sequence hasn't
+  finished yet, a new one is not started.
+
+  Parameters:   none
+  Return value: none
+*/
+void ADC_Start(void) {
+    if(ADC14->CTL0 & 0x00010000) return;    //last sequence still converting
+    ADC14->CTL0 |= 0x00000001;              //start sequence of samples
+}
+
+
+/*
+  ADC14_IRQHandler
+  ----------------------------------------------------------------------
+  ADC14 interrupt that occurs when the last ADC14MEM is loaded at the end
+  of the sequence or when a sample is above its window threshold. Samples
+  above their threshold are reported to the window task first. At the end
+  of the sequence, the results are read, which clears their flags, and put
+  in the sample array before the user task is called.
+
+  The flags are saved first since reading the results clears them, and a
+  sequence from ADC_In run while interrupts were disabled leaves the
+  interrupt pending even though its results were already read.
+
+  Parameters:   none
+  Return value: none
+*/
+void ADC14_IRQHandler(void) {
+    uint32_t i, above;
+    uint32_t status = ADC14->IFGR0 & ADC14->IER0;  //save flags before results are read
+
+    if(ADC14->IFGR1 & 0x00000008)                   //sample above threshold
+    {
+        ADC14->CLRIFGR1 = 0x00000008;
+        above = 0;
+        for(i = 0; i < ADC_Num_Chnls; i++)
+        {
+            if(Window_Thresh[i] && ADC14->MEM[i] > Window_Thresh[i]) above |= 1 << ADC_Chnls[i].index;
+        }
+        if(above) (*ADC14WindowTask)(above);
+    }
+    if(status == 0) return;                         //sequence not done or results already read
+
+    for(i = 0; i < ADC_Num_Chnls; i++)              //read data from ADC14 channels
+    {
+        ADC_Samples[ADC_Chnls[i].index] = ADC14->MEM[i];
+    }
+    (*ADC14Task)();
 }
 
 
+/*
+  ADC0_InitDMA
+  ----------------------------------------------------------------------
+  Initialize ADC0 to sample every channel in the table on its own,
+  triggered by Timer A1 output 1, with the DMA moving results into
+  ping-pong buffers. The CPU is only interrupted when a buffer of num_seqs
+  sequences is full, and the user task gets that buffer while the DMA
+  fills the other.
+
+  The ADC14MEM registers are filled in repeat-sequence mode with num_seqs
+  copies of the table, so one DMA request at the end of the sequence
+  moves a whole buffer. Each trigger converts one channel, so every
+  channel is sampled at 1/num_chnls of the trigger rate. DMA channel 7
+  and DMA_INT1(priority 1) are used.
+
+  The DMA can't reorder samples, so buffers are in table order:
+  samples[num_chnls*n + i] is channel i of the table, n = 0 to num_seqs-1
+
+  A buffer is at most the 32 ADC14MEM registers, so num_chnls*num_seqs
+  can't be over ADC_MAX_CHNLS. Untested: RCR_main.c doesn't use this
+  mode and the host sim doesn't model the DMA.
+
+  Parameters:   1) table of channels to sample, must stay valid after init
+                2) number of channels in table,
+                       max is ADC_MAX_CHNLS
+                3) function pointer to user task called with each full buffer
+                4) number of sequences per buffer,
+                       max is ADC_MAX_CHNLS/num_chnls
+                5) time(in 12 MHz clk cycles) between ADC14 triggers,
+                       see TimerA1_InitTrigger
+  Return value: true if started, false if a count is 0 or the buffer
+                would be over ADC_MAX_CHNLS, which leaves the ADC as it was
+*/
+bool ADC0_InitDMA(const adc_chnl_desc* chnls, uint32_t num_chnls, void(*task)(uint32_t*), uint32_t num_seqs, uint16_t period) {
+    uint32_t num_samples;
+    if(num_chnls == 0 || num_chnls > ADC_MAX_CHNLS) return false;
+    if(num_seqs == 0 || num_seqs > ADC_MAX_CHNLS/num_chnls) return false;   //nothing changed yet
+    ADC14DMATask = task;
+    num_samples = num_seqs*num_chnls;
 
+    // smclk_12MHz, divide by 1, TA1.1 trigger for sample, repeat sequence of channels, 1 trigger per channel
+    ADC_Seq_Init(chnls,num_chnls,num_seqs,0x1C260010);   //DMA is requested when last ADC14MEM is loaded
+
+    // dst inc 32-bit, src inc 32-bit, arbitrate after 32 transfers, ping-pong mode
+    DMA_Control_Word = 0xAA014003 | ((num_samples-1) << 4);
+    DMA_ControlTable[DMA_CH7_PRI]   = (uint32_t)(uintptr_t)&ADC14->MEM[num_samples-1];
+    DMA_ControlTable[DMA_CH7_PRI+1] = (uint32_t)(uintptr_t)&ADC_PingPong[0][num_samples-1];
+    DMA_ControlTable[DMA_CH7_PRI+2] = DMA_Control_Word;
+    DMA_ControlTable[DMA_CH7_ALT]   = (uint32_t)(uintptr_t)&ADC14->MEM[num_samples-1];
+    DMA_ControlTable[DMA_CH7_ALT+1] = (uint32_t)(uintptr_t)&ADC_PingPong[1][num_samples-1];
+    DMA_ControlTable[DMA_CH7_ALT+2] = DMA_Control_Word;
+
+    DMA_Control->CFG         = 0x00000001;          //enable DMA controller
+    DMA_Control->CTLBASE     = (uint32_t)(uintptr_t)DMA_ControlTable;
+    DMA_Channel->CH_SRCCFG[7] = 0x00000007;         //channel 7 requested by ADC14
+    DMA_Control->ALTCLR      = 0x00000080;          //channel 7 starts with primary structure
+    DMA_Control->USEBURSTCLR = 0x00000080;
+    DMA_Control->REQMASKCLR  = 0x00000080;
+    DMA_Channel->INT0_CLRFLG = 0x00000080;
+    DMA_Channel->INT1_SRCCFG = 0x00000027;          //DMA_INT1 enabled for channel 7 done
+
+    NVIC->IP[33]   = 0x20;              //priority 1, same as sample timer
+    NVIC->ISER[1] |= 0x00000002;        //enable DMA_INT1(irq 33) interrupt
+
+    DMA_Control->ENASET      = 0x00000080;          //enable channel 7
+    ADC14->CTL0   |= 0x00000002;        //enable ADC14, waits for Timer A1 trigger
+    TimerA1_InitTrigger(period);
+    return true;
+}
 
+
+/*
+  DMA_INT1_IRQHandler
+  ----------------------------------------------------------------------
+  DMA interrupt that occurs when a ping-pong buffer is full. The DMA has
+  already switched to the other buffer, so the finished structure is
+  reloaded before the user task is called with the full buffer.
+
+  Parameters:   none
+  Return value: none
+*/
+void DMA_INT1_IRQHandler(void) {
+    DMA_Channel->INT0_CLRFLG = 0x00000080;          //clear channel 7 done flag
+    if(DMA_Control->ALTSET & 0x00000080)            //now on alternate, primary buffer is full
+    {
+        DMA_ControlTable[DMA_CH7_PRI+2] = DMA_Control_Word;
+        (*ADC14DMATask)(ADC_PingPong[0]);
+    }
+    else                                            //now on primary, alternate buffer is full
+    {
+        DMA_ControlTable[DMA_CH7_ALT+2] = DMA_Control_Word;
+        (*ADC14DMATask)(ADC_PingPong[1]);
+    }
+}
+
+
+/*
+  ADC_InitWindow
+  ----------------------------------------------------------------------
+  Arm the ADC14 window comparator so a raw sample above a threshold
+  interrupts right after its conversion and calls a user task, without
+  waiting for the Low Pass Filter. Each channel has its own threshold
+  in ADC counts(0 leaves the channel unchecked). The ADC14 only has 2
+  threshold registers, so at most 2 different thresholds can be used.
+
+  The user task is called from ADC14_IRQHandler with a mask of the
+  channels whose latest sample is above their threshold, where bit n is
+  table index n. Assumes ADC0_Init or ADC0_InitTask has been called, it
+  is not meant for the DMA mode. Uses the same priority as the ADC14
+  sequence interrupt(1).
+
+  Parameters:   1) function pointer to user task to be called during interrupt
+                2) array of thresholds(in ADC counts), indexed by the table index
+  Return value: true if set, false if more than 2 different thresholds,
+                which leaves the window as it was
+*/
+bool ADC_InitWindow(void(*task)(uint32_t), const uint16_t* thresh) {
+    uint32_t i;
+    uint16_t t, hi0 = 0, hi1 = 0;
+
+    for(i = 0; i < ADC_Num_Chnls; i++)  //give each different threshold its own register pair
+    {
+        t = thresh[ADC_Chnls[i].index];
+        if(t == 0 || t == hi0 || t == hi1) continue;
+        if(hi0 == 0) hi0 = t;
+        else if(hi1 == 0) hi1 = t;
+        else return false;              //nothing changed yet, the old window stays armed
+    }
+
+    ADC14WindowTask = task;
+    for(i = 0; i < ADC_Num_Chnls; i++)
+    {
+        Window_Thresh[i] = thresh[ADC_Chnls[i].index];      //ADC14MEM order
+    }
+    ADC14->CTL0 &= ~0x00000002;         //disable ADC14 and wait for it to be available
+    while(ADC14->CTL0 & 0x00010000) {}
+    ADC14->LO0 = 0;                     //only the high threshold is used
+    ADC14->HI0 = hi0;
+    ADC14->LO1 = 0;
+    ADC14->HI1 = hi1;
+    for(i = 0; i < ADC_Num_Chnls; i++)
+    {
+        ADC14->MCTL[i] &= ~0x0000C000;
+        if(Window_Thresh[i] == 0) continue;
+        if(Window_Thresh[i] == hi0) ADC14->MCTL[i] |= 0x00004000;  //comparator on, ADC14HI0/LO0
+        else ADC14->MCTL[i] |= 0x0000C000;                         //comparator on, ADC14HI1/LO1
+    }
+    ADC14->CLRIFGR1 = 0x0000000E;       //clear old comparator flags
+    ADC14->IER1     = 0x00000008;       //interrupt when above high threshold
+
+    NVIC->IP[24]   = 0x20;              //priority 1, same as sample timer
+    NVIC->ISER[0] |= 0x01000000;        //enable ADC14(irq 24) interrupt
+    ADC14->CTL0   |= 0x00000002;        //enable ADC14
+    return true;
+}
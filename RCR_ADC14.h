@@ -4,8 +4,9 @@
 
 // Provides driver functions for ADC
 // sampling to collect data for IR sensors.
-// Currently set up for channels 14, 16, and
-// 17 to get raw data as requested by software.
+// The channels sampled are given by a table
+// of channel descriptions, so sensors can be
+// added without changing the driver.
 
 
 /* This example accompanies the book
@@ -47,53 +48,171 @@ policies, either expressed or implied, of the FreeBSD Project.
 #define RCR_ADC14_H_
 
 
+#include <stdbool.h>
 
-#define ANALOG_CHNLS 3      //number of analog sensors on system
+#define ADC_MAX_CHNLS 32    //ADC14 has 32 MEM registers to sequence through
 
-/*
- Hardware connections
- ---------------------------------------------------------
- P9.0 = analog channel 17, right sensor
- P6.1 = analog channel 14, center sensor
- P9.1 = analog channel 16, left sensor
-*/
+// sample_time values, in ADC14CLK cycles
+#define ADC_SHT_4     0
+#define ADC_SHT_8     1
+#define ADC_SHT_16    2
+#define ADC_SHT_32    3
+#define ADC_SHT_64    4
+#define ADC_SHT_96    5
+#define ADC_SHT_128   6
+#define ADC_SHT_192   7
+
+
+// description of an analog channel to be sampled, the
+// driver builds its sequence from a table of these
+struct ADC_Chnl_Desc
+{
+    uint8_t anlg_chnl;      // analog input, 0-23 for A0-A23
+    uint8_t port;           // port of the input pin(ex. 9 for P9.0)
+    uint8_t pin;            // pin number of the input pin(ex. 0 for P9.0)
+    uint8_t index;          // where its sample goes in the sample array
+    uint8_t sample_time;    // ADC_SHT value
+};
+
+typedef struct ADC_Chnl_Desc adc_chnl_desc;
 
 
 /*
-  ADC0_Init_Ch17_14_16
+  ADC0_Init
   ----------------------------------------------------------------------
   Initialize 14-bit ADC0 in software-triggered mode to take measurements
-  when the associated function is called. The sequence of measurements
-  starts at channel 14, then channel 17, and ends at channel 16. Interrupts
-  are disabled and Timer1A is used to time the samples. The 12 MHz SMCLK
-  is used and sampling is set to 96 cycles and converting takes 16 cycles.
-  The 3.3V analog supply is used as reference.
-
-  Parameters:   none
+  when ADC_In is called. The sequence of measurements follows the order
+  of the channel table, and the pins in the table are set to their analog
+  function. Interrupts are disabled and Timer1A is used to time the samples.
+  The 12 MHz SMCLK is used and converting takes 16 cycles. The ADC14 only
+  has 2 sampling times shared by all of its MEM registers, so the longest
+  sample_time in the table is used for every channel. The 3.3V analog
+  supply is used as reference.
+
+  Parameters:   1) table of channels to sample, must stay valid after init
+                2) number of channels in table,
+                       max is ADC_MAX_CHNLS
   Return value: none
 */
-void ADC0_Init_Ch17_14_16(void);
+void ADC0_Init(const adc_chnl_desc* chnls, uint32_t num_chnls);
 
 
 
 /*
-  ADC_In17_14_16
+  ADC_In
   ----------------------------------------------------------------------
-  Trigger a single ADC measurement on A17, A14, and
-  A16 each, wait for them to complete, and put the results in
-  the pointers given. The pointers are 32-bit integers
-  because the ADC registers are 32 bits. In this case, bits
-  31-16 are undefined and bits 15-14 are zero.
+  Trigger a single ADC measurement on every channel in the table, wait
+  for them to complete, and put each result in the sample array at its
+  index from the table. The results are 32-bit integers because the ADC
+  registers are 32 bits. In this case, bits 31-16 are undefined and
+  bits 15-14 are zero.
   Busy-wait synchronization used, ADC input voltage range is
-  0 to 3.3V, and assumes ADC0_Init_Ch17_14_16() has been called
+  0 to 3.3V, and assumes ADC0_Init or ADC0_InitTask has been called
   and ADC is 14-bit precision.
 
-  Parameters:   1) address to store ch 17/right sample
-                2) address to store ch 14/center sample
-                3) address to store ch 16/left sample
+  Parameters:   1) array to store samples in, indexed by the table index
+  Return value: none
+*/
+void ADC_In(uint32_t* samples);
+
+
+
+/*
+  ADC0_InitTask
+  ----------------------------------------------------------------------
+  Initialize ADC0 the same way as ADC0_Init, but arm the ADC14 interrupt
+  for the end of the sequence(last channel in table) so the samples are
+  handed to a user task instead of busy-waiting for them. Sequences are
+  started with ADC_Start, usually from the Timer A1 task. Once all
+  conversions finish, the sample array is filled the same way as ADC_In
+  and the user task is called.
+
+  The interrupt has a priority of 1, the same as Timer A1, so the bump
+  switches can still preempt it. ADC_In can still be used, but only
+  before interrupts are enabled(ex. to get the first filter samples).
+
+  Parameters:   1) table of channels to sample, must stay valid after init
+                2) number of channels in table,
+                       max is ADC_MAX_CHNLS
+                3) array filled with samples before user task is called,
+                       indexed by the table index
+                4) function pointer to user task called at end of sequence
+  Return value: none
+*/
+void ADC0_InitTask(const adc_chnl_desc* chnls, uint32_t num_chnls, uint32_t* samples, void(*task)(void));
+
+
+/*
+  ADC_Start
+  ----------------------------------------------------------------------
+  Trigger a single ADC measurement on every channel in the table and
+  return without waiting. The results are given to the user task from
+  ADC0_InitTask when the sequence is done. If the last sequence hasn't
+  finished yet, a new one is not started.
+
+  Parameters:   none
   Return value: none
 */
-void ADC_In17_14_16(uint32_t *ch17, uint32_t *ch14, uint32_t *ch16);
+void ADC_Start(void);
+
+
+/*
+  ADC0_InitDMA
+  ----------------------------------------------------------------------
+  Initialize ADC0 to sample every channel in the table on its own,
+  triggered by Timer A1 output 1, with the DMA moving results into
+  ping-pong buffers. The CPU is only interrupted when a buffer of num_seqs
+  sequences is full, and the user task gets that buffer while the DMA
+  fills the other.
+
+  The ADC14MEM registers are filled in repeat-sequence mode with num_seqs
+  copies of the table, so one DMA request at the end of the sequence
+  moves a whole buffer. Each trigger converts one channel, so every
+  channel is sampled at 1/num_chnls of the trigger rate. DMA channel 7
+  and DMA_INT1(priority 1) are used.
+
+  The DMA can't reorder samples, so buffers are in table order:
+  samples[num_chnls*n + i] is channel i of the table, n = 0 to num_seqs-1
+
+  A buffer is at most the 32 ADC14MEM registers, so num_chnls*num_seqs
+  can't be over ADC_MAX_CHNLS. Untested: RCR_main.c doesn't use this
+  mode and the host sim doesn't model the DMA.
+
+  Parameters:   1) table of channels to sample, must stay valid after init
+                2) number of channels in table,
+                       max is ADC_MAX_CHNLS
+                3) function pointer to user task called with each full buffer
+                4) number of sequences per buffer,
+                       max is ADC_MAX_CHNLS/num_chnls
+                5) time(in 12 MHz clk cycles) between ADC14 triggers,
+                       see TimerA1_InitTrigger
+  Return value: true if started, false if a count is 0 or the buffer
+                would be over ADC_MAX_CHNLS, which leaves the ADC as it was
+*/
+bool ADC0_InitDMA(const adc_chnl_desc* chnls, uint32_t num_chnls, void(*task)(uint32_t*), uint32_t num_seqs, uint16_t period);
+
+
+/*
+  ADC_InitWindow
+  ----------------------------------------------------------------------
+  Arm the ADC14 window comparator so a raw sample above a threshold
+  interrupts right after its conversion and calls a user task, without
+  waiting for the Low Pass Filter. Each channel has its own threshold
+  in ADC counts(0 leaves the channel unchecked). The ADC14 only has 2
+  threshold registers, so at most 2 different thresholds can be used.
+
+  The user task is called from ADC14_IRQHandler with a mask of the
+  channels whose latest sample is above their threshold, where bit n is
+  table index n. Assumes ADC0_Init or ADC0_InitTask has been called, it
+  is not meant for the DMA mode. Uses the same priority as the ADC14
+  sequence interrupt(1).
+
+  Parameters:   1) function pointer to user task to be called during interrupt
+                2) array of thresholds(in ADC counts), indexed by the table index
+  Return value: true if set, false if more than 2 different thresholds,
+                which leaves the window as it was
+*/
+bool ADC_InitWindow(void(*task)(uint32_t), const uint16_t* thresh);
 
 
 #endif /* RCR_ADC14_H_ */
@@ -0,0 +1,66 @@
+// RCR_Battery.c
+// Compatible with MSP432
+// Abhi Kallur
+
+// Provides the battery voltage from an ADC14
+// sample of the divided down battery, filtered
+// slowly so motor current spikes don't show.
+
+
+#include <stdint.h>
+#include "RCR_Battery.h"
+
+
+/*
+ Hardware connections
+ ---------------------------------------------------------
+ P6.0 (analog ch 15) connected to battery through a 1/3 divider
+     (20k from battery, 10k to ground)
+*/
+
+// mV at the battery for a 14-bit sample with the 3.3V reference, in Q16
+#define BATT_MV_Q16   ((uint32_t)(3300.0*BATT_DIVIDER*65536/16384))
+
+static int32_t Batt_Filt;       //filtered sample, Q16
+
+
+/*
+  Battery_Init
+  ----------------------------------------------------------------------
+  Start the battery filter at a first sample, so it doesn't have to
+  climb up from 0.
+
+  Parameters:   1) 14-bit ADC sample of the battery divider
+  Return value: none
+*/
+void Battery_Init(uint32_t ADCval) {
+    Batt_Filt = ADCval << 16;
+}
+
+/*
+  Battery_Update
+  ----------------------------------------------------------------------
+  Add a sample to the battery filter. The filter is a single-pole IIR
+  in Q16 fixed-point that moves 1/2^BATT_TAU_LOG2 of the way to each
+  sample, so it follows the pack draining but not the sag while the
+  motors start. Call it at a steady rate, like from the ADC14 task.
+
+  Parameters:   1) 14-bit ADC sample of the battery divider
+  Return value: filtered battery voltage in mV
+*/
+uint32_t Battery_Update(uint32_t ADCval) {
+    Batt_Filt += ((int32_t)(ADCval << 16) - Batt_Filt) >> BATT_TAU_LOG2;
+    return Battery_mV();
+}
+
+/*
+  Battery_mV
+  ----------------------------------------------------------------------
+  Gives the filtered battery voltage.
+
+  Parameters:   none
+  Return value: battery voltage in mV
+*/
+uint32_t Battery_mV(void) {
+    return ((uint64_t)Batt_Filt*BATT_MV_Q16) >> 32;
+}
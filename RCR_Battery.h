@@ -0,0 +1,60 @@
+// RCR_Battery.h
+// Compatible with MSP432
+// Abhi Kallur
+
+// Provides the battery voltage from an ADC14
+// sample of the divided down battery, filtered
+// slowly so motor current spikes don't show.
+
+#ifndef RCR_BATTERY_H_
+#define RCR_BATTERY_H_
+
+
+/*
+ Hardware connections
+ ---------------------------------------------------------
+ P6.0 (analog ch 15) connected to battery through a 1/3 divider
+     (20k from battery, 10k to ground)
+*/
+
+#define BATT_CHNL      15       //analog channel of the battery divider
+#define BATT_DIVIDER   3        //battery voltage over the pin voltage
+#define BATT_TAU_LOG2  8        //filter time constant is 2^8 samples, 2.56 s at 10 ms
+
+
+/*
+  Battery_Init
+  ----------------------------------------------------------------------
+  Start the battery filter at a first sample, so it doesn't have to
+  climb up from 0.
+
+  Parameters:   1) 14-bit ADC sample of the battery divider
+  Return value: none
+*/
+void Battery_Init(uint32_t ADCval);
+
+/*
+  Battery_Update
+  ----------------------------------------------------------------------
+  Add a sample to the battery filter. The filter is a single-pole IIR
+  in Q16 fixed-point that moves 1/2^BATT_TAU_LOG2 of the way to each
+  sample, so it follows the pack draining but not the sag while the
+  motors start. Call it at a steady rate, like from the ADC14 task.
+
+  Parameters:   1) 14-bit ADC sample of the battery divider
+  Return value: filtered battery voltage in mV
+*/
+uint32_t Battery_Update(uint32_t ADCval);
+
+/*
+  Battery_mV
+  ----------------------------------------------------------------------
+  Gives the filtered battery voltage.
+
+  Parameters:   none
+  Return value: battery voltage in mV
+*/
+uint32_t Battery_mV(void);
+
+
+#endif /* RCR_BATTERY_H_ */
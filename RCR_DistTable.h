@@ -0,0 +1,45 @@
+// RCR_DistTable.h
+// Compatible with MSP432
+// Generated by tools/gen_dist_table.c, do not edit
+
+// Distance lookup table for ConvertDist made from the
+// calibration equation in RCR_IRDistance.h. Entries are in
+// 1/16 mm at every 64 ADC counts.
+// Max error: 6 mm over 0-16383, 1 mm over 100-800 mm
+
+#ifndef RCR_DISTTABLE_H_
+#define RCR_DISTTABLE_H_
+
+#define DIST_TABLE_SHIFT 6      //ADC value >> shift gives segment
+#define DIST_TABLE_FRAC  4      //fraction bits in entries
+
+static const uint16_t Dist_Table[257] = {
+    35075, 31551, 28668, 26266, 24233, 22491, 20981, 19661, 18495, 17459,
+    16532, 15698, 14944, 14258, 13631, 13057, 12529, 12041, 11590, 11171,
+    10780, 10416, 10075,  9756,  9456,  9173,  8907,  8655,  8418,  8192,
+     7978,  7775,  7582,  7398,  7223,  7055,  6895,  6742,  6595,  6455,
+     6320,  6191,  6067,  5947,  5832,  5721,  5615,  5512,  5413,  5317,
+     5224,  5135,  5048,  4964,  4883,  4805,  4729,  4655,  4583,  4513,
+     4446,  4380,  4317,  4255,  4194,  4136,  4079,  4023,  3969,  3916,
+     3865,  3815,  3766,  3718,  3671,  3626,  3582,  3538,  3496,  3455,
+     3414,  3375,  3336,  3298,  3261,  3225,  3189,  3154,  3120,  3087,
+     3054,  3022,  2991,  2960,  2930,  2901,  2872,  2843,  2815,  2788,
+     2761,  2734,  2709,  2683,  2658,  2633,  2609,  2585,  2562,  2539,
+     2517,  2494,  2473,  2451,  2430,  2409,  2389,  2369,  2349,  2329,
+     2310,  2291,  2273,  2254,  2236,  2219,  2201,  2184,  2167,  2150,
+     2134,  2117,  2101,  2085,  2070,  2054,  2039,  2024,  2010,  1995,
+     1981,  1966,  1952,  1939,  1925,  1912,  1898,  1885,  1872,  1859,
+     1847,  1834,  1822,  1810,  1798,  1786,  1774,  1763,  1751,  1740,
+     1729,  1718,  1707,  1696,  1686,  1675,  1665,  1654,  1644,  1634,
+     1624,  1614,  1605,  1595,  1586,  1576,  1567,  1558,  1549,  1540,
+     1531,  1522,  1513,  1504,  1496,  1487,  1479,  1471,  1463,  1454,
+     1446,  1438,  1431,  1423,  1415,  1407,  1400,  1392,  1385,  1377,
+     1370,  1363,  1356,  1349,  1342,  1335,  1328,  1321,  1314,  1308,
+     1301,  1294,  1288,  1281,  1275,  1269,  1262,  1256,  1250,  1244,
+     1238,  1232,  1226,  1220,  1214,  1208,  1202,  1197,  1191,  1185,
+     1180,  1174,  1169,  1163,  1158,  1153,  1147,  1142,  1137,  1132,
+     1127,  1122,  1117,  1112,  1107,  1102,  1097,  1092,  1087,  1082,
+     1078,  1073,  1068,  1064,  1059,  1054,  1050
+};
+
+#endif /* RCR_DISTTABLE_H_ */
@@ -44,9 +44,13 @@ policies, either expressed or implied, of the FreeBSD Project.
 
 
 #include <stdint.h>
-#include <stdlib.h>
-//#include "ADC14.h"
-#include "msp.h"
+#include <stdbool.h>
+#include "RCR_IRDistance.h"
+#include "RCR_DistTable.h"
+
+#if defined(__TI_ARM_V7M4__) || defined(__ARM_FEATURE_DSP)
+#include "msp.h"                    //CMSIS packed SIMD intrinsics
+#endif
 
 
 /*
@@ -60,30 +64,212 @@ policies, either expressed or implied, of the FreeBSD Project.
 */
 
 
-#define MAX_ANLG_CHNLS 32         //limit for MSP432 mcu
-#define HEAP_SIZE      4096       //adjust this if you change value in linker properties
+#define ADC_MAX        16383      //14-bit ADC
+#define FILTER_MASK    (FILTER_SIZE-1)
+
 
-// empirically-derived values for calibration equation, assumes 14-bit ADC
-#define CAL_CONST      0.91       // k value
-#define INV_SLOPE      126716.5   // 1/m value
-#define INTERCEPT      575.6511   // b/m value
-#define CM_TO_MM       10
+// packed 16-bit add and subtract for LowPassFilter_All. On target
+// these are single Cortex-M4 instructions, on host they're plain C
+// that wraps each 16-bit lane the same way.
+#if defined(__TI_ARM_V7M4__) || defined(__ARM_FEATURE_DSP)
+#define SADD16(a,b)    __SADD16((a),(b))
+#define SSUB16(a,b)    __SSUB16((a),(b))
+#else
+static uint32_t SADD16(uint32_t a, uint32_t b) {
+    return ((a + b) & 0xFFFF) | (((a >> 16) + (b >> 16)) << 16);
+}
+
+static uint32_t SSUB16(uint32_t a, uint32_t b) {
+    return ((a - b) & 0xFFFF) | (((a >> 16) - (b >> 16)) << 16);
+}
+#endif
+
+
+// data structure to hold a sliding median window. The
+// heap array is indexed from -size/2 to size/2 around the
+// median at 0, with a max heap of smaller samples at negative
+// indexes and a min heap of larger samples at positive ones.
+// The children of heap index i are 2i and 2i+1(2i-1 if negative).
+struct Median_Window
+{
+    uint16_t  data[MEDIAN_MAX_SIZE];        //samples in the order they came in
+    int8_t    pos[MEDIAN_MAX_SIZE];         //heap index of each sample
+    int8_t    heap_buff[MEDIAN_MAX_SIZE];   //data index of each heap node
+    int8_t*   heap;                         //points to middle of heap_buff
+    uint32_t  size;
+    uint32_t  idx;                          //oldest sample, replaced next
+};
+
+typedef struct Median_Window median_window;
 
 
 // data structure to hold Low Pass Filter parameters
 // for each analog channel
 struct Analog_Chnl
 {
-    uint32_t* data_buff;
     uint32_t  rolling_sum;
     uint32_t  buff_cnt;
+    uint32_t  type;                     //FILTER_BOXCAR, FILTER_EMA, or FILTER_BIQUAD
+    int32_t   alpha;                    //Q15
+    int32_t   stage[2];                 //IIR filter outputs in Q16
+    median_window median;               //median prefilter, unused if size is 0
 };
 
 typedef struct Analog_Chnl analog_chnl;
 
 
-static analog_chnl* analog_sensors;     //array of all analog sensors/channels
-static uint32_t     filter_size;        //standard filter size for all sensors(may make this dynamic if I add different sensors)
+// one boxcar buffer index for all channels, so channel 2k and
+// 2k+1 can be read and written as one 32-bit pair
+union Filter_Row
+{
+    uint16_t  chnl[FILTER_LANES];       //14-bit samples
+    uint32_t  pair[FILTER_LANES/2];
+};
+
+typedef union Filter_Row filter_row;
+
+
+static analog_chnl analog_sensors[FILTER_CHNLS];    //array of all analog sensors/channels
+static filter_row  boxcar_buff[FILTER_SIZE];        //boxcar samples, struct of arrays
+
+
+/*
+  Median_Less, Median_Swap
+  ----------------------------------------------------------------------
+  Helpers for the median heaps. Median_Less compares the samples at 2
+  heap indexes. Median_Swap swaps them if the one at i is less than the
+  one at j and keeps each sample's heap index up to date.
+
+  Parameters:   1) median window
+                2) heap index i
+                3) heap index j
+  Return value: true if heap[i] < heap[j](and swapped for Median_Swap)
+*/
+static bool Median_Less(median_window* m, int32_t i, int32_t j) {
+    return m->data[m->heap[i]] < m->data[m->heap[j]];
+}
+
+static bool Median_Swap(median_window* m, int32_t i, int32_t j) {
+    int8_t temp;
+    if(!Median_Less(m,i,j)) return false;
+    temp       = m->heap[i];
+    m->heap[i] = m->heap[j];
+    m->heap[j] = temp;
+    m->pos[m->heap[i]] = i;
+    m->pos[m->heap[j]] = j;
+    return true;
+}
+
+
+/*
+  Median_MinDown, Median_MaxDown
+  ----------------------------------------------------------------------
+  Move a sample down the min(positive) or max(negative) heap until it
+  is in order with its children. Start at the child of the node that
+  changed, or at 1/-1 to fix the heap under a new median.
+
+  Parameters:   1) median window
+                2) heap index to start at
+  Return value: none
+*/
+static void Median_MinDown(median_window* m, int32_t i) {
+    int32_t count = m->size/2;                          //samples in each heap
+    for(; i <= count; i *= 2)
+    {
+        if(i > 1 && i < count && Median_Less(m,i+1,i)) i++;     //pick smaller child
+        if(!Median_Swap(m,i,i/2)) break;
+    }
+}
+
+static void Median_MaxDown(median_window* m, int32_t i) {
+    int32_t count = m->size/2;
+    for(; i >= -count; i *= 2)
+    {
+        if(i < -1 && i > -count && Median_Less(m,i,i-1)) i--;   //pick larger child
+        if(!Median_Swap(m,i/2,i)) break;
+    }
+}
+
+
+/*
+  Median_MinUp, Median_MaxUp
+  ----------------------------------------------------------------------
+  Move a sample up the min(positive) or max(negative) heap, past the
+  median if needed, until it is in order with its parent.
+
+  Parameters:   1) median window
+                2) heap index of sample
+  Return value: true if sample became the new median
+*/
+static bool Median_MinUp(median_window* m, int32_t i) {
+    while(i > 0 && Median_Swap(m,i,i/2)) i /= 2;
+    return i == 0;
+}
+
+static bool Median_MaxUp(median_window* m, int32_t i) {
+    while(i < 0 && Median_Swap(m,i/2,i)) i /= 2;
+    return i == 0;
+}
+
+
+/*
+  Median_Init
+  ----------------------------------------------------------------------
+  Fill a median window with copies of the first sample. Heap nodes are
+  handed out median, max, min, max, min... so both heaps are full.
+
+  Parameters:   1) median window
+                2) number of samples in window, odd up to MEDIAN_MAX_SIZE
+                3) first sample
+  Return value: none
+*/
+static void Median_Init(median_window* m, uint32_t size, uint16_t data) {
+    uint32_t i;
+    m->size = size;
+    m->idx  = 0;
+    m->heap = &m->heap_buff[size/2];
+    for(i = 0; i < size; i++)
+    {
+        m->data[i] = data;
+        m->pos[i]  = ((i+1)/2) * ((i&1) ? -1 : 1);
+        m->heap[m->pos[i]] = i;
+    }
+}
+
+
+/*
+  Median_Insert
+  ----------------------------------------------------------------------
+  Replace the oldest sample in the window with a new one and fix the
+  heaps in O(log n), then return the median.
+
+  Parameters:   1) median window
+                2) new sample
+  Return value: median of the window
+*/
+static uint16_t Median_Insert(median_window* m, uint16_t data) {
+    int32_t  p   = m->pos[m->idx];
+    uint16_t old = m->data[m->idx];
+    m->data[m->idx] = data;
+    m->idx = (m->idx+1 == m->size) ? 0 : m->idx+1;
+
+    if(p > 0)               //replaced sample is in min heap
+    {
+        if(old < data) Median_MinDown(m,p*2);
+        else if(Median_MinUp(m,p)) Median_MaxDown(m,-1);
+    }
+    else if(p < 0)          //replaced sample is in max heap
+    {
+        if(data < old) Median_MaxDown(m,p*2);
+        else if(Median_MaxUp(m,p)) Median_MinDown(m,1);
+    }
+    else                    //replaced sample was the median
+    {
+        Median_MaxDown(m,-1);
+        Median_MinDown(m,1);
+    }
+    return m->data[m->heap[0]];
+}
 
 /*
   ConvertDist
@@ -103,56 +289,98 @@ static uint32_t     filter_size;        //standard filter size for all sensors(m
   constants recalculated.
   Calibration equation: R = (1/m)/(ADCval + (b/m)) - k
 
+  The equation isn't calculated here since it needs double precision
+  math that the FPU can't do. Instead it uses Dist_Table, which is made
+  from the equation by tools/gen_dist_table.c, and interpolates between
+  its entries. The table must be regenerated if the constants change.
+
   Parameters:   1) 14-bit filtered ADC value to calculate distance from
   Return value: distance away from nearest object in mm,
                     useful range is 100-800 mm
 */
 uint32_t ConvertDist(uint32_t ADCval) {
-    //ARM Cortex-M4F processor has Floating Point Unit to efficiently handle
-    //floating point operations
-    return ((INV_SLOPE/(ADCval + INTERCEPT)) - CAL_CONST)*CM_TO_MM;
+    uint32_t seg, frac;
+    if(ADCval > ADC_MAX) ADCval = ADC_MAX;
+    seg  = ADCval >> DIST_TABLE_SHIFT;                  //weighted average of the entries on each side
+    frac = ADCval & ((1 << DIST_TABLE_SHIFT)-1);
+    return (Dist_Table[seg]*((1 << DIST_TABLE_SHIFT)-frac) + Dist_Table[seg+1]*frac) >> (DIST_TABLE_SHIFT + DIST_TABLE_FRAC);
+}
+
+
+/*
+  ConvertADC
+  ----------------------------------------------------------------------
+  Convert a distance into the ADC sample the GP2Y0A21YK0F would give
+  for it, the inverse of ConvertDist. This is meant for turning distance
+  thresholds into ADC counts at init time, like for the ADC14 window
+  comparator, since it uses the same floating point constants.
+  Closer objects give larger samples.
+  Inverse equation: ADCval = (1/m)/(R + k) - (b/m)
+
+  Parameters:   1) distance in mm, useful range is 100-800 mm
+  Return value: 14-bit ADC value for that distance
+*/
+uint32_t ConvertADC(uint32_t dist) {
+    double ADCval = (INV_SLOPE/(((double)dist/CM_TO_MM) + CAL_CONST)) - INTERCEPT;
+    if(ADCval < 0) return 0;
+    if(ADCval > ADC_MAX) return ADC_MAX;
+    return ADCval;
 }
 
 
 /*
   LowPassFilter_Init
   ----------------------------------------------------------------------
-  Create and initialize an array of analog channels for use as low
-  pass filters. There's an element for each channel that holds its
-  filter buffer, sum of all elements in its buffer, and current index
-  of the buffer. Each channel will have all elements of their filter
-  buffer set to their ADC sample in the init_data array to start off.
-  Each successive sample will overwrite the oldest sample in the buffer.
-
-  The filter buffers are dynamically allocated and the current HEAP_SIZE
-  is 4096. That means the max size for the filter buffers is 341. If you
-  need more, increase the heap size in linker properties and update HEAP_SIZE.
-
-  Parameters:   1) number of analog channels used on robot,
-                       max is MAX_ANLG_CHNLS
-                2) number of elements in filter buffer for each channel,
-                       max is HEAP_SIZE/num_channels/4 bytes
-                3) array of first raw ADC sample for each channel
+  Initialize the low pass filters for all FILTER_CHNLS analog channels.
+  Each channel picks its own filter type from the config array:
+
+  FILTER_BOXCAR: moving average with a buffer of FILTER_SIZE elements,
+                 its sum, and current index of the buffer. Each successive
+                 sample will overwrite the oldest sample in the buffer.
+  FILTER_EMA:    single-pole IIR(exponential moving average),
+                 y += alpha*(x - y)
+  FILTER_BIQUAD: critically damped 2nd-order IIR, done as 2 identical
+                 EMA stages in a row. This is the same as a biquad with
+                 a double pole at 1-alpha, but with less rounding error.
+
+  The IIR filters only keep O(1) state in Q16 fixed-point and alpha is
+  Q15, so a smaller alpha is smoother but responds slower. Every filter
+  starts off settled at its ADC sample in the init_data array.
+  Run tools/filter_report.c to see the delay and noise attenuation
+  of each setting before picking one.
+
+  Any filter can also have a sliding median of the last median_size
+  samples in front of it. This throws out single-sample spikes from the
+  IR sensors before they get averaged in. Its delay is median_size/2
+  samples. An even size is rounded up to the next odd size.
+
+  The filters are statically allocated, so the number of channels and
+  FILTER_SIZE are picked at compile time in RCR_IRDistance.h and no
+  heap is needed.
+
+  Parameters:   1) array of first raw ADC sample for each channel
+                2) array of filter settings for each channel
   Return value: none
 */
-void LowPassFilter_Init(uint32_t num_channels,uint32_t size,uint32_t* init_data) {
+void LowPassFilter_Init(uint32_t* init_data, const filter_config* config) {
     int x,y;
-    if(num_channels > MAX_ANLG_CHNLS) num_channels = MAX_ANLG_CHNLS;
-    if(size*num_channels*sizeof(uint32_t) > HEAP_SIZE)
-        filter_size = (uint32_t)((HEAP_SIZE/num_channels)/sizeof(uint32_t));
-    else
-        filter_size = size;
-
-    analog_sensors = (analog_chnl*)malloc(num_channels*sizeof(analog_chnl));     //create buffer for all channels of any size
-    for(x = 0; x < num_channels; x++)                                           //if I want more distance sensors, I can easily add more channels
+    for(x = 0; x < FILTER_CHNLS; x++)               //if I want more distance sensors, I can increase FILTER_CHNLS
     {
-        analog_sensors[x].data_buff   = (uint32_t *)malloc(filter_size*sizeof(uint32_t));
+        analog_sensors[x].type        = config[x].type;
+        analog_sensors[x].alpha       = config[x].alpha;
+        analog_sensors[x].stage[0]    = init_data[x] << 16;     //IIR stages start settled
+        analog_sensors[x].stage[1]    = init_data[x] << 16;
+        analog_sensors[x].median.size = 0;
+        if(config[x].median_size > 0)
+        {
+            Median_Init(&analog_sensors[x].median,(config[x].median_size > MEDIAN_MAX_SIZE) ? MEDIAN_MAX_SIZE : (config[x].median_size | 1),init_data[x]);
+        }
         analog_sensors[x].rolling_sum = 0;
         analog_sensors[x].buff_cnt    = 0;
-        for(y = 0; y < filter_size; y++)              //prefill with current sample
+        for(y = 0; y < FILTER_SIZE; y++)              //prefill with current sample
         {
-            analog_sensors[x].data_buff[y] = init_data[x];
-            analog_sensors[x].rolling_sum += analog_sensors[x].data_buff[y];   //calculate sum in advance
+            boxcar_buff[y].chnl[x] = init_data[x];
+            analog_sensors[x].rolling_sum += boxcar_buff[y].chnl[x];   //calculate sum in advance
         }
     }
 }
@@ -161,13 +389,24 @@ void LowPassFilter_Init(uint32_t num_channels,uint32_t size,uint32_t* init_data)
 /*
   LowPassFilter
   ----------------------------------------------------------------------
-  Takes in raw sample and fills it into filter buffer for the channel
-  selected. The new sample is added twice and the 2 oldest samples are
-  written over, similar to a FIFO. The average value of the buffer
-  is calculated, acting as a low pass filter.
+  Takes in raw sample and runs it through the filter picked for the
+  channel selected in LowPassFilter_Init.
+
+  For FILTER_BOXCAR, the sample is filled into the filter buffer. The
+  new sample is added twice and the 2 oldest samples are written over,
+  similar to a FIFO. The average value of the buffer is calculated,
+  acting as a low pass filter. A larger FILTER_SIZE makes the filter
+  smoother but slower to respond. FILTER_SIZE is a power of 2, so
+  wrapping the index is a mask and the average is a shift instead
+  of divides.
 
-  If initialized with a larger size, the filter will be more accurate
-  but take longer to process.
+  For FILTER_EMA and FILTER_BIQUAD, each stage moves alpha of the way
+  toward its input, using one 32x32 multiply per stage.
+
+  If the channel has a median prefilter, the sample goes through it
+  first. The median is kept up to date in O(log n) per sample with a
+  max heap of the smaller half of the window and a min heap of the
+  larger half, instead of sorting the window each time.
 
   Parameters:   1) analog channel selected
                 2) 14-bit raw ADC sample to be filtered
@@ -176,11 +415,105 @@ void LowPassFilter_Init(uint32_t num_channels,uint32_t size,uint32_t* init_data)
 */
 uint32_t LowPassFilter(uint32_t chnl,uint32_t data) {
     analog_chnl* current = &analog_sensors[chnl];                   //store current channels data
+    if(current->median.size) data = Median_Insert(&current->median,data);
+    if(current->type != FILTER_BOXCAR)
+    {
+        current->stage[0] += (int32_t)(((int64_t)((int32_t)(data << 16) - current->stage[0])*current->alpha) >> 15);
+        if(current->type == FILTER_EMA) return (current->stage[0] + 0x8000) >> 16;
+        current->stage[1] += (int32_t)(((int64_t)(current->stage[0] - current->stage[1])*current->alpha) >> 15);
+        return (current->stage[1] + 0x8000) >> 16;
+    }
     current->rolling_sum += (2*data);                               //add 2 copies of latest sample, subtract 2 oldest samples
-    current->rolling_sum -= current->data_buff[current->buff_cnt];
-    current->rolling_sum -= current->data_buff[((current->buff_cnt+1)%filter_size)];
-    current->data_buff[current->buff_cnt] = data;                   //update buffer and count and wrap if necessary
-    current->data_buff[((current->buff_cnt+1)%filter_size)] = data;
-    current->buff_cnt = (current->buff_cnt+2)%filter_size;
-    return current->rolling_sum/filter_size;
+    current->rolling_sum -= boxcar_buff[current->buff_cnt].chnl[chnl];
+    current->rolling_sum -= boxcar_buff[(current->buff_cnt+1)&FILTER_MASK].chnl[chnl];
+    boxcar_buff[current->buff_cnt].chnl[chnl] = data;               //update buffer and count and wrap if necessary
+    boxcar_buff[(current->buff_cnt+1)&FILTER_MASK].chnl[chnl] = data;
+    current->buff_cnt = (current->buff_cnt+2)&FILTER_MASK;
+    return current->rolling_sum >> FILTER_SIZE_LOG2;
+}
+
+
+/*
+  LowPassFilter_All
+  ----------------------------------------------------------------------
+  Runs one raw sample from every channel through its filter in a single
+  call, giving the same results as calling LowPassFilter for channels
+  0 to FILTER_CHNLS-1 in order.
+
+  The boxcar buffers are stored as a struct of arrays, with the samples
+  of all channels for the same buffer index next to each other. So 2
+  channels share each 32-bit word and their running sums are updated
+  together with the Cortex-M4 packed 16-bit instructions(__SADD16 and
+  __SSUB16) instead of one channel at a time. The change in each sum,
+  2*new - 2 oldest, always fits in a signed 16-bit lane for 14-bit
+  samples. When compiled for a host without the DSP extension, plain C
+  versions of the same instructions are used instead, so both builds
+  give bit-exact results.
+
+  A pair of channels only takes the packed path if both are boxcar
+  filters at the same buffer index. Anything else(IIR filters, an odd
+  channel at the end) falls back to LowPassFilter.
+
+  It has not been timed against FILTER_CHNLS calls to LowPassFilter.
+  The host sim charges no cycles for code that only touches RAM, so
+  that needs DWT CYCCNT on the LaunchPad. Until then it is not known to
+  be any faster.
+
+  Parameters:   1) array of FILTER_CHNLS 14-bit raw ADC samples
+                2) array to store FILTER_CHNLS filtered values in,
+                   can be the same array as the samples
+  Return value: none
+*/
+void LowPassFilter_All(const uint32_t* data, uint32_t* filt) {
+    uint32_t x, cnt, next, in0, in1, packed, delta;
+    analog_chnl *lo, *hi;
+    for(x = 0; x+1 < FILTER_CHNLS; x += 2)
+    {
+        lo = &analog_sensors[x];
+        hi = &analog_sensors[x+1];
+        if(lo->type != FILTER_BOXCAR || hi->type != FILTER_BOXCAR || lo->buff_cnt != hi->buff_cnt)
+        {
+            in0 = data[x];                                      //read both before writing in case filt == data
+            in1 = data[x+1];
+            filt[x]   = LowPassFilter(x,in0);
+            filt[x+1] = LowPassFilter(x+1,in1);
+            continue;
+        }
+        in0 = lo->median.size ? Median_Insert(&lo->median,data[x])   : data[x];
+        in1 = hi->median.size ? Median_Insert(&hi->median,data[x+1]) : data[x+1];
+        cnt    = lo->buff_cnt;
+        next   = (cnt+1)&FILTER_MASK;
+        packed = in0 | (in1 << 16);                             //channel x in low half, x+1 in high half
+        delta  = SADD16(packed,packed);                         //2*new - 2 oldest for both channels at once
+        delta  = SSUB16(delta,boxcar_buff[cnt].pair[x/2]);
+        delta  = SSUB16(delta,boxcar_buff[next].pair[x/2]);
+        boxcar_buff[cnt].pair[x/2]  = packed;
+        boxcar_buff[next].pair[x/2] = packed;
+        lo->rolling_sum += (int16_t)(delta & 0xFFFF);           //sign extend each lane into its sum
+        hi->rolling_sum += (int16_t)(delta >> 16);
+        lo->buff_cnt = hi->buff_cnt = (cnt+2)&FILTER_MASK;
+        filt[x]   = lo->rolling_sum >> FILTER_SIZE_LOG2;
+        filt[x+1] = hi->rolling_sum >> FILTER_SIZE_LOG2;
+    }
+    if(x < FILTER_CHNLS) filt[x] = LowPassFilter(x,data[x]);   //odd channel left over
+}
+
+
+/*
+  ConvertDist_All
+  ----------------------------------------------------------------------
+  Converts the filtered samples of every channel into distances in mm
+  with ConvertDist in one call.
+
+  Parameters:   1) array of FILTER_CHNLS filtered ADC values
+                2) array to store FILTER_CHNLS distances in mm,
+                   can be the same array as the ADC values
+  Return value: none
+*/
+void ConvertDist_All(const uint32_t* filt, uint32_t* dist) {
+    uint32_t x;
+    for(x = 0; x < FILTER_CHNLS; x++)
+    {
+        dist[x] = ConvertDist(filt[x]);
+    }
 }
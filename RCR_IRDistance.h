@@ -51,10 +51,43 @@ policies, either expressed or implied, of the FreeBSD Project.
 */
 
 
+// empirically-derived values for calibration equation, assumes 14-bit ADC
+// ConvertDist uses RCR_DistTable.h, run tools/gen_dist_table.c after changing these
+#define CAL_CONST      0.91       // k value
+#define INV_SLOPE      126716.5   // 1/m value
+#define INTERCEPT      575.6511   // b/m value
+#define CM_TO_MM       10
+
+
+#define ANALOG_CHNLS 3      //number of IR sensors on robot
 #define RIGHT  0
 #define CENTER 1
 #define LEFT   2
 
+// Low Pass Filter sizes, storage for all channels is allocated at compile time
+#define FILTER_CHNLS     ANALOG_CHNLS           //number of channels with a filter
+#define FILTER_SIZE_LOG2 6                      //filter buffers hold 2^6 samples
+#define FILTER_SIZE      (1 << FILTER_SIZE_LOG2)
+#define FILTER_LANES     ((FILTER_CHNLS+1) & ~1)  //channels rounded up to even, for packed pairs
+
+// Low Pass Filter types, see LowPassFilter_Init
+#define FILTER_BOXCAR    0
+#define FILTER_EMA       1
+#define FILTER_BIQUAD    2
+
+#define MEDIAN_MAX_SIZE  15     //largest sliding median prefilter window
+
+
+// filter settings picked for each channel at init
+struct Filter_Config
+{
+    uint8_t   type;         // FILTER_BOXCAR, FILTER_EMA, or FILTER_BIQUAD
+    uint16_t  alpha;        // Q15 smoothing factor for IIR filters(32768 = 1.0), unused by boxcar
+    uint8_t   median_size;  // sliding median window in front of filter, odd up to MEDIAN_MAX_SIZE, 0 = none
+};
+
+typedef struct Filter_Config filter_config;
+
 
 /*
   ConvertDist
@@ -74,6 +107,11 @@ policies, either expressed or implied, of the FreeBSD Project.
   constants recalculated.
   Calibration equation: R = (1/m)/(ADCval + (b/m)) - k
 
+  The equation isn't calculated here since it needs double precision
+  math that the FPU can't do. Instead it uses Dist_Table, which is made
+  from the equation by tools/gen_dist_table.c, and interpolates between
+  its entries. The table must be regenerated if the constants change.
+
   Parameters:   1) 14-bit filtered ADC value to calculate distance from
   Return value: distance away from nearest object in mm,
                     useful range is 100-800 mm
@@ -81,40 +119,80 @@ policies, either expressed or implied, of the FreeBSD Project.
 uint32_t ConvertDist(uint32_t ADCval);
 
 
+/*
+  ConvertADC
+  ----------------------------------------------------------------------
+  Convert a distance into the ADC sample the GP2Y0A21YK0F would give
+  for it, the inverse of ConvertDist. This is meant for turning distance
+  thresholds into ADC counts at init time, like for the ADC14 window
+  comparator, since it uses the same floating point constants.
+  Closer objects give larger samples.
+  Inverse equation: ADCval = (1/m)/(R + k) - (b/m)
+
+  Parameters:   1) distance in mm, useful range is 100-800 mm
+  Return value: 14-bit ADC value for that distance
+*/
+uint32_t ConvertADC(uint32_t dist);
+
+
 /*
   LowPassFilter_Init
   ----------------------------------------------------------------------
-  Create and initialize an array of analog channels for use as low
-  pass filters. There's an element for each channel that holds its
-  filter buffer, sum of all elements in its buffer, and current index
-  of the buffer. Each channel will have all elements of their filter
-  buffer set to their ADC sample in the init_data array to start off.
-  Each successive sample will overwrite the oldest sample in the buffer.
-
-  The filter buffers are dynamically allocated and the current HEAP_SIZE
-  is 4096. That means the max size for the filter buffers is 341. If you
-  need more, increase the heap size in linker properties and update HEAP_SIZE.
-
-  Parameters:   1) number of analog channels used on robot,
-                       max is MAX_ANLG_CHNLS
-                2) number of elements in filter buffer for each channel,
-                       max is HEAP_SIZE/num_channels/4 bytes
-                3) array of first raw ADC sample for each channel
+  Initialize the low pass filters for all FILTER_CHNLS analog channels.
+  Each channel picks its own filter type from the config array:
+
+  FILTER_BOXCAR: moving average with a buffer of FILTER_SIZE elements,
+                 its sum, and current index of the buffer. Each successive
+                 sample will overwrite the oldest sample in the buffer.
+  FILTER_EMA:    single-pole IIR(exponential moving average),
+                 y += alpha*(x - y)
+  FILTER_BIQUAD: critically damped 2nd-order IIR, done as 2 identical
+                 EMA stages in a row. This is the same as a biquad with
+                 a double pole at 1-alpha, but with less rounding error.
+
+  The IIR filters only keep O(1) state in Q16 fixed-point and alpha is
+  Q15, so a smaller alpha is smoother but responds slower. Every filter
+  starts off settled at its ADC sample in the init_data array.
+  Run tools/filter_report.c to see the delay and noise attenuation
+  of each setting before picking one.
+
+  Any filter can also have a sliding median of the last median_size
+  samples in front of it. This throws out single-sample spikes from the
+  IR sensors before they get averaged in. Its delay is median_size/2
+  samples. An even size is rounded up to the next odd size.
+
+  The filters are statically allocated, so the number of channels and
+  FILTER_SIZE are picked at compile time in RCR_IRDistance.h and no
+  heap is needed.
+
+  Parameters:   1) array of first raw ADC sample for each channel
+                2) array of filter settings for each channel
   Return value: none
 */
-void LowPassFilter_Init(uint32_t num_channels,uint32_t size,uint32_t* init_data);
+void LowPassFilter_Init(uint32_t* init_data, const filter_config* config);
 
 
 /*
   LowPassFilter
   ----------------------------------------------------------------------
-  Takes in raw sample and fills it into filter buffer for the channel
-  selected. The new sample is added twice and the 2 oldest samples are
-  written over, similar to a FIFO. The average value of the buffer
-  is calculated, acting as a low pass filter.
+  Takes in raw sample and runs it through the filter picked for the
+  channel selected in LowPassFilter_Init.
 
-  If initialized with a larger size, the filter will be more accurate
-  but take longer to process.
+  For FILTER_BOXCAR, the sample is filled into the filter buffer. The
+  new sample is added twice and the 2 oldest samples are written over,
+  similar to a FIFO. The average value of the buffer is calculated,
+  acting as a low pass filter. A larger FILTER_SIZE makes the filter
+  smoother but slower to respond. FILTER_SIZE is a power of 2, so
+  wrapping the index is a mask and the average is a shift instead
+  of divides.
+
+  For FILTER_EMA and FILTER_BIQUAD, each stage moves alpha of the way
+  toward its input, using one 32x32 multiply per stage.
+
+  If the channel has a median prefilter, the sample goes through it
+  first. The median is kept up to date in O(log n) per sample with a
+  max heap of the smaller half of the window and a min heap of the
+  larger half, instead of sorting the window each time.
 
   Parameters:   1) analog channel selected
                 2) 14-bit raw ADC sample to be filtered
@@ -123,4 +201,51 @@ void LowPassFilter_Init(uint32_t num_channels,uint32_t size,uint32_t* init_data)
 */
 uint32_t LowPassFilter(uint32_t chnl,uint32_t data);
 
+/*
+  LowPassFilter_All
+  ----------------------------------------------------------------------
+  Runs one raw sample from every channel through its filter in a single
+  call, giving the same results as calling LowPassFilter for channels
+  0 to FILTER_CHNLS-1 in order.
+
+  The boxcar buffers are stored as a struct of arrays, with the samples
+  of all channels for the same buffer index next to each other. So 2
+  channels share each 32-bit word and their running sums are updated
+  together with the Cortex-M4 packed 16-bit instructions(__SADD16 and
+  __SSUB16) instead of one channel at a time. The change in each sum,
+  2*new - 2 oldest, always fits in a signed 16-bit lane for 14-bit
+  samples. When compiled for a host without the DSP extension, plain C
+  versions of the same instructions are used instead, so both builds
+  give bit-exact results.
+
+  A pair of channels only takes the packed path if both are boxcar
+  filters at the same buffer index. Anything else(IIR filters, an odd
+  channel at the end) falls back to LowPassFilter.
+
+  It has not been timed against FILTER_CHNLS calls to LowPassFilter.
+  The host sim charges no cycles for code that only touches RAM, so
+  that needs DWT CYCCNT on the LaunchPad. Until then it is not known to
+  be any faster.
+
+  Parameters:   1) array of FILTER_CHNLS 14-bit raw ADC samples
+                2) array to store FILTER_CHNLS filtered values in,
+                   can be the same array as the samples
+  Return value: none
+*/
+void LowPassFilter_All(const uint32_t* data, uint32_t* filt);
+
+
+/*
+  ConvertDist_All
+  ----------------------------------------------------------------------
+  Converts the filtered samples of every channel into distances in mm
+  with ConvertDist in one call.
+
+  Parameters:   1) array of FILTER_CHNLS filtered ADC values
+                2) array to store FILTER_CHNLS distances in mm,
+                   can be the same array as the ADC values
+  Return value: none
+*/
+void ConvertDist_All(const uint32_t* filt, uint32_t* dist);
+
 #endif /* RCR_IRDISTANCE_H_ */
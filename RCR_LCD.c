@@ -15,9 +15,10 @@
 #include "msp.h"
 #include "RCR_SPI_A3.h"
 #include "RCR_LCD.h"
+#include "RCR_Pin.h"
 
-#define DC          (*((volatile uint8_t *)0x42099058))   //directly accesses 9.6
-#define RESET       (*((volatile uint8_t *)0x4209904C))   //directly accesses 9.3
+#define DC          PIN_OUT(P9,6)   //directly accesses 9.6
+#define RESET       PIN_OUT(P9,3)   //directly accesses 9.3
 
 #define PXLS_W      5       //pixel width of a character
 #define LCD_ROWS    6
@@ -281,7 +282,7 @@ void LCD_OutUInt(uint32_t num) {
         arr[k] = temp%10;
         temp /= 10;
     }
-    for(k = 0; k < digits; k++) {
+    for(k = 0; k < (int)digits; k++) {
         LCD_WriteChar((char)(arr[k]+48));           //convert number to ASCII and transmit as char
     }
     free(arr);                                      //free up temporary array memory
@@ -0,0 +1,159 @@
+// RCR_Motion.c
+// Compatible with MSP432
+// Abhi Kallur
+
+// Runs a queue of motion segments, like back up
+// for 300 ms then pivot 90 degrees, from the
+// Timer A2 interrupt. Each segment drives the
+// wheels at a speed until its time, distance or
+// exit condition is reached, without the main
+// loop watching over it.
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "msp.h"
+#include "CortexM.h"
+#include "RCR_TimerA2.h"
+#include "RCR_Tach.h"
+#include "RCR_Motor.h"
+#include "RCR_Motion.h"
+
+static motion_seg Motion_Queue[MOTION_QUEUE];   //segments in order, from Motion_Head
+static uint8_t  Motion_Head;            //running or next segment
+static uint8_t  Motion_Count;           //segments in the queue, including the running one
+static uint8_t  Motion_Running;         //Motion_Queue[Motion_Head] has started
+static uint16_t Motion_ms;              //time in the running segment
+static int32_t  Motion_Left, Motion_Right;  //encoder counts when it started
+static void (*MotionDone)(void);        // user task called when the queue runs out
+
+
+// start the segment at the head, called with interrupts masked
+static void Motion_Start(void) {
+    motion_seg* seg = &Motion_Queue[Motion_Head];
+    Motion_Running = 1;
+    Motion_ms = 0;
+    Tach_Count(&Motion_Left,&Motion_Right);
+    Motor_SetSpeed(seg->left,seg->right);
+}
+
+// whether the running segment has reached a limit
+static bool Motion_Done(const motion_seg* seg) {
+    int32_t left, right;
+    if(seg->ms && Motion_ms >= seg->ms) return true;
+    if(seg->edges)
+    {
+        Tach_Count(&left,&right);
+        left  -= Motion_Left;
+        right -= Motion_Right;
+        if(left < 0)  left  = -left;
+        if(right < 0) right = -right;
+        if(left >= seg->edges || right >= seg->edges) return true;
+    }
+    if(seg->until && (*seg->until)()) return true;
+    if(!seg->ms && !seg->edges && !seg->until && Motion_Count > 1) return true;
+    return false;
+}
+
+// Timer A2 task, ends the running segment and starts the next
+// once any brake has run its time
+static void Motion_Tick(void) {
+    if(!Motion_Running)
+    {
+        if(Motion_Count && !Motor_Braking()) Motion_Start();
+        return;
+    }
+    Motion_ms++;
+    if(!Motion_Done(&Motion_Queue[Motion_Head])) return;
+
+    Motion_Head = (Motion_Head + 1) % MOTION_QUEUE;
+    Motion_Count--;
+    Motion_Running = 0;
+    if(Motion_Count)
+    {
+        if(!Motor_Braking()) Motion_Start();
+        return;
+    }
+    if(!Motor_Braking()) Motor_SetSpeed(0,0);   //a brake already holds them
+    if(MotionDone) (*MotionDone)();
+}
+
+
+/*
+  Motion_Init
+  ----------------------------------------------------------------------
+  Start the motion queue empty. Timer A2 checks the running segment
+  every ms with a priority of 2 and starts the next one as soon as it
+  ends, so segment boundaries don't wait for the main loop. The speeds
+  take effect at the next PWM period like any motor command. Assumes
+  Motor_Init() and Tach_Init() have been called.
+
+  Parameters:   1) function pointer to user task called from the
+                       interrupt when the last segment in the queue
+                       ends, can be null
+  Return value: none
+*/
+void Motion_Init(void(*done)(void)) {
+    MotionDone     = done;
+    Motion_Head    = 0;
+    Motion_Count   = 0;
+    Motion_Running = 0;
+    TimerA2_Init(&Motion_Tick,MOTION_TICK);
+}
+
+/*
+  Motion_Add
+  ----------------------------------------------------------------------
+  Copy a segment to the end of the queue. If the queue was idle it
+  starts right away, or while a Motor_Brake is braking, as soon as the
+  brake time runs out, so a brake isn't cut short by the next segment.
+  A segment that ends during a brake waits the same way. A brake held
+  until the next command(brake time 0) holds the queue until then.
+  When the last segment ends the wheels are set to 0 mm/s and the done
+  task is called.
+
+  Parameters:   1) segment to add
+  Return value: true if added, false if the queue is full
+*/
+bool Motion_Add(const motion_seg* seg) {
+    long sr = StartCritical();
+    if(Motion_Count == MOTION_QUEUE)
+    {
+        EndCritical(sr);
+        return false;
+    }
+    Motion_Queue[(Motion_Head + Motion_Count) % MOTION_QUEUE] = *seg;
+    Motion_Count++;
+    if(!Motion_Running && !Motor_Braking()) Motion_Start();
+    EndCritical(sr);
+    return true;
+}
+
+/*
+  Motion_Clear
+  ----------------------------------------------------------------------
+  Drop every segment, including the running one, without calling the
+  done task. The motors keep the last command, so follow this with a
+  motor command like Motor_Brake.
+
+  Parameters:   none
+  Return value: none
+*/
+void Motion_Clear(void) {
+    long sr = StartCritical();
+    Motion_Count   = 0;
+    Motion_Running = 0;
+    EndCritical(sr);
+}
+
+/*
+  Motion_Busy
+  ----------------------------------------------------------------------
+  Gives whether a segment is running or waiting for a brake to end.
+
+  Parameters:   none
+  Return value: true if the queue has a segment
+*/
+bool Motion_Busy(void) {
+    return Motion_Count != 0;
+}
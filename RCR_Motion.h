@@ -0,0 +1,90 @@
+// RCR_Motion.h
+// Compatible with MSP432
+// Abhi Kallur
+
+// Runs a queue of motion segments, like back up
+// for 300 ms then pivot 90 degrees, from the
+// Timer A2 interrupt. Each segment drives the
+// wheels at a speed until its time, distance or
+// exit condition is reached, without the main
+// loop watching over it.
+
+#ifndef RCR_MOTION_H_
+#define RCR_MOTION_H_
+
+#include <stdbool.h>
+
+#define MOTION_QUEUE  8         //segments the queue can hold
+#define MOTION_TICK   1500      //Timer A2 cycles between checks, 1 ms
+
+
+// one step of a maneuver, it ends when the first of its limits is
+// reached, a segment with no limits runs until another is queued
+struct Motion_Seg
+{
+    int16_t  left;              // left wheel speed in mm/s, see Motor_SetSpeed
+    int16_t  right;             // right wheel speed in mm/s
+    uint16_t ms;                // time limit in ms, 0 for none
+    uint16_t edges;             // encoder edges on the wheel that has gone farthest, 0 for none
+    bool   (*until)(void);      // exit condition checked every ms, null for none
+};
+
+typedef struct Motion_Seg motion_seg;
+
+
+/*
+  Motion_Init
+  ----------------------------------------------------------------------
+  Start the motion queue empty. Timer A2 checks the running segment
+  every ms with a priority of 2 and starts the next one as soon as it
+  ends, so segment boundaries don't wait for the main loop. The speeds
+  take effect at the next PWM period like any motor command. Assumes
+  Motor_Init() and Tach_Init() have been called.
+
+  Parameters:   1) function pointer to user task called from the
+                       interrupt when the last segment in the queue
+                       ends, can be null
+  Return value: none
+*/
+void Motion_Init(void(*done)(void));
+
+/*
+  Motion_Add
+  ----------------------------------------------------------------------
+  Copy a segment to the end of the queue. If the queue was idle it
+  starts right away, or while a Motor_Brake is braking, as soon as the
+  brake time runs out, so a brake isn't cut short by the next segment.
+  A segment that ends during a brake waits the same way. A brake held
+  until the next command(brake time 0) holds the queue until then.
+  When the last segment ends the wheels are set to 0 mm/s and the done
+  task is called.
+
+  Parameters:   1) segment to add
+  Return value: true if added, false if the queue is full
+*/
+bool Motion_Add(const motion_seg* seg);
+
+/*
+  Motion_Clear
+  ----------------------------------------------------------------------
+  Drop every segment, including the running one, without calling the
+  done task. The motors keep the last command, so follow this with a
+  motor command like Motor_Brake.
+
+  Parameters:   none
+  Return value: none
+*/
+void Motion_Clear(void);
+
+/*
+  Motion_Busy
+  ----------------------------------------------------------------------
+  Gives whether a segment is running or waiting for a brake to end.
+
+  Parameters:   none
+  Return value: true if the queue has a segment
+*/
+bool Motion_Busy(void);
+
+
+#endif /* RCR_MOTION_H_ */
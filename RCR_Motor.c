@@ -46,7 +46,95 @@ policies, either expressed or implied, of the FreeBSD Project.
 #include "msp.h"
 #include "CortexM.h"
 #include "RCR_TimerA0.h"
+#include "RCR_TimerA2.h"
+#include "RCR_Tach.h"
 #include "RCR_Motor.h"
+#include "RCR_MotorID.h"
+#include "RCR_Pin.h"
+
+
+#define CONTROL_HZ   MOTOR_CONTROL_HZ
+#define CONTROL_TICK (1500000/CONTROL_HZ)   //Timer A2 clk cycles at 1.5 MHz, see RCR_TimerA2.h
+
+// single store pin writes, Motor_Stop runs from the bump interrupt
+// and must not be undone by a read-modify-write it preempted
+#define LEFT_DIR     PIN_OUT(P5,4)
+#define RIGHT_DIR    PIN_OUT(P5,5)
+#define LEFT_EN      PIN_OUT(P3,7)
+#define RIGHT_EN     PIN_OUT(P3,6)
+#define LEFT_PWM     PIN_OUT(P2,7)
+#define RIGHT_PWM    PIN_OUT(P2,6)
+#define LEFT_PWM_ON  PIN_SEL0(P2,7)     //1 gives the pin to Timer A0
+#define RIGHT_PWM_ON PIN_SEL0(P2,6)
+
+// one wheel of the ramp engine, velocities are duty*CONTROL_HZ so
+// adding the acceleration once a control period needs no divide
+struct Motor_Ramp {
+    int32_t target;             //commanded velocity
+    int32_t vel;                //velocity staged in the timer
+    int32_t acc;                //Q15 duty per second
+};
+typedef struct Motor_Ramp motor_ramp;
+
+static motor_ramp Ramp_Left, Ramp_Right;
+static int32_t  Ramp_Accel;             //max acceleration, 0 steps straight to the target
+static int32_t  Ramp_Jerk;              //max change in acceleration per control period, 0 is unlimited
+
+static uint8_t  Motor_Dir;              //staged P5 direction bits
+static uint8_t  Motor_Target;           //P5 direction bits of the command
+static uint8_t  Motor_Running;          //ramp armed on the rollover, cleared by Motor_Stop
+
+#define BRAKE_PULSE  1                  //Brake_Phase values
+#define BRAKE_HOLD   2
+
+#define SPEED_KP     10900      //Q15 duty per mm/s of error, Q8
+#define SPEED_SLEW   2200       //Q15 duty the output can lead the ramp by
+#define SPEED_ERR    2000       //mm/s, largest error the loop acts on, more than a wheel at full speed the wrong way
+#define SPEED_INT    (MAX_DUTY*256)     //integral limit, full duty on its own, Q8
+
+// feedforward and integral gain of a wheel from its measured motor, see
+// RCR_MotorID.h, the integral cancels the motor's lag so the loop acts
+// like a single integrator
+#define SPEED_FF(gain)  ((32768*256)/(gain))                    //Q15 duty per mm/s, Q8
+#define SPEED_KI(tau)   ((SPEED_KP*1000)/(CONTROL_HZ*(tau)))    //Q15 duty per mm/s of error added each control period, Q8
+#define SPEED_KI_TUNED  440     //hand-tuned integral gain, used until a wheel has a measured TAU_MS
+
+#ifdef MOTOR_LEFT_TAU_MS
+#define LEFT_KI   SPEED_KI(MOTOR_LEFT_TAU_MS)
+#else
+#define LEFT_KI   SPEED_KI_TUNED
+#endif
+#ifdef MOTOR_RIGHT_TAU_MS
+#define RIGHT_KI  SPEED_KI(MOTOR_RIGHT_TAU_MS)
+#else
+#define RIGHT_KI  SPEED_KI_TUNED
+#endif
+
+// one wheel of the speed loop
+struct Motor_PI {
+    int32_t target;             //mm/s
+    int32_t integral;           //Q15 duty, Q8
+    int32_t ff;                 //Q15 duty per mm/s, Q8
+    int32_t deadband;           //Q15 duty before the wheel turns
+    int32_t ki;                 //Q15 duty per mm/s of error each control period, Q8
+};
+typedef struct Motor_PI motor_pi;
+
+static motor_pi PI_Left  = {0, 0, SPEED_FF(MOTOR_LEFT_GAIN),  MOTOR_LEFT_DEADBAND,  LEFT_KI};
+static motor_pi PI_Right = {0, 0, SPEED_FF(MOTOR_RIGHT_GAIN), MOTOR_RIGHT_DEADBAND, RIGHT_KI};
+static uint8_t  Speed_On;               //speed loop drives the ramp, cleared by any other command
+
+#define SUPPLY_ONE   4096       //Q12 battery scale of 1.0
+#define SUPPLY_MIN   2048       //0.5, a pack well above nominal
+#define SUPPLY_MAX   6144       //1.5, a pack nearly dead
+
+static int32_t  Supply_Scale = SUPPLY_ONE;  //Q12 duty multiplier for the battery, see Motor_SetSupply
+
+static uint8_t  Brake_Phase;            //0 when not braking
+static uint16_t Brake_Periods;          //control periods left in this phase
+static uint16_t Brake_Hold_Periods;     //brake time after the pulse, 0 holds until the next command
+
+static void Motor_Control(void);        //Timer A2 task every control period, below Motor_SetSpeed
 
 
 /*
@@ -69,13 +157,18 @@ policies, either expressed or implied, of the FreeBSD Project.
   The motors are initially stopped, the driver IC's are initially powered
   down, and the PWM speed control is uninitialized.
 
-  Timer A0 is initialized for a 15000 clock cycle period that is 1/10
-  of the motor time constants of 100 ms.
+  Timer A0 is initialized for the PWM frequency given. Above 20 kHz the
+  motors can't be heard and the ripple on the supply is easier to
+  filter, 100 Hz is 1/10 of the motor time constants of 100 ms. Duty
+  cycles everywhere in this file are Q15 fractions of full power, so
+  the frequency can change without changing any of them. The ramp,
+  speed loop and brake run at MOTOR_CONTROL_HZ from Timer A2 whatever
+  the frequency, and stage their changes for the next PWM rollover.
 
-  Parameters:   none
+  Parameters:   1) PWM frequency in Hz, up to 120000
   Return value: none
 */
-void Motor_Init(void) {
+void Motor_Init(uint32_t pwmHz) {
   P3->SEL0 &= ~0xC0;
   P3->SEL1 &= ~0xC0;
   P3->DIR  |=  0xC0;
@@ -86,19 +179,404 @@ void Motor_Init(void) {
   P5->DIR  |=  0x30;
   P5->OUT  &= ~0x30;
 
-  TimerA0_Init(15000,0,0);
+  TimerA0_Init(pwmHz,0,0);
+  TimerA0_Shadow(true);         //duty cycles change at the period rollover
+  TimerA2_InitTask(&Motor_Control,CONTROL_TICK);
 }
 
 /*
   Motor_Stop
   ----------------------------------------------------------------------
-  Stop the motors by powering down the driver IC's.
+  Stop the motors by powering down the driver IC's. This is the
+  emergency stop, it skips any ramp from Motor_SetRamp and drops any
+  command still waiting for the PWM period. It runs with interrupts
+  masked, so the control period can't run the speed loop halfway
+  through and stage a new command that turns them back on.
 
   Parameters:   none
   Return value: none
 */
 void Motor_Stop(void) {
-    P3->OUT  &= ~0xC0;
+    long sr = StartCritical();
+    Speed_On      = 0;          //the speed loop can't issue another command
+    Motor_Running = 0;          //a staged command can't turn them back on
+    Brake_Phase   = 0;
+    LEFT_EN  = 0;
+    RIGHT_EN = 0;
+    Ramp_Left.vel  = Ramp_Left.acc  = 0;
+    Ramp_Right.vel = Ramp_Right.acc = 0;
+    EndCritical(sr);
+}
+
+/*
+  Motor_SetRamp
+  ----------------------------------------------------------------------
+  Limit how fast Motor_SetVelocity changes the duty cycles. Every
+  MOTOR_CONTROL_HZ period the velocity of each wheel moves toward its command, with the
+  acceleration changing by no more than the jerk limit and easing off
+  so the command is reached without overshoot. A reversal ramps down
+  through zero before the direction pin changes. Motor_Stop skips the
+  ramp and stops right away.
+
+  Parameters:   1) max acceleration in Q15 duty per second,
+                       0 steps straight to each command
+                2) max jerk in Q15 duty per second per second,
+                       0 lets the acceleration step
+  Return value: none
+*/
+void Motor_SetRamp(uint32_t accel, uint32_t jerk) {
+    long sr = StartCritical();
+    Ramp_Accel = accel;
+    Ramp_Jerk  = jerk/CONTROL_HZ;
+    if(jerk && !Ramp_Jerk) Ramp_Jerk = 1;
+    EndCritical(sr);
+}
+
+// limit an unsigned duty so it can be negated
+static int16_t Motor_Limit(uint16_t duty) {
+    return (duty > MAX_DUTY) ? MAX_DUTY : duty;
+}
+
+// move one wheel's velocity a period closer to its target
+static void Ramp_Step(motor_ramp* w) {
+    int32_t err = w->target - w->vel;
+    int32_t want = (err > 0) ? Ramp_Accel : (err < 0) ? -Ramp_Accel : 0;
+    int64_t ease;
+
+    if(!Ramp_Accel)
+    {
+        w->vel = w->target;
+        return;
+    }
+    if(Ramp_Jerk)
+    {
+        //velocity gained while the acceleration eases back to 0
+        ease = (int64_t)w->acc*w->acc/(2*Ramp_Jerk) + ((w->acc < 0) ? -w->acc : w->acc)/2;
+        if((err > 0 && w->acc > 0 && ease >= err) || (err < 0 && w->acc < 0 && ease >= -err)) want = 0;
+        if(want > w->acc + Ramp_Jerk) want = w->acc + Ramp_Jerk;
+        if(want < w->acc - Ramp_Jerk) want = w->acc - Ramp_Jerk;
+    }
+    w->acc  = want;
+    w->vel += w->acc;
+    if((err >= 0 && w->vel >= w->target) || (err <= 0 && w->vel <= w->target))
+    {
+        w->vel = w->target;     //reached, a small jerk beats an overshoot
+        w->acc = 0;
+    }
+}
+
+// stage the next velocities in the timer's shadow registers
+static void Ramp_Advance(void) {
+    uint8_t dir = FORWARD;
+    int32_t left, right;
+    Ramp_Step(&Ramp_Left);
+    Ramp_Step(&Ramp_Right);
+    left  = Ramp_Left.vel/CONTROL_HZ;
+    right = Ramp_Right.vel/CONTROL_HZ;
+    if(left < 0)
+    {
+        dir |= 0x10;            //left motor backward
+        left = -left;
+    }
+    if(right < 0)
+    {
+        dir |= 0x20;            //right motor backward
+        right = -right;
+    }
+    if(left == 0)  dir |= Motor_Dir & 0x10;     //no need to flip a pin at 0 duty
+    if(right == 0) dir |= Motor_Dir & 0x20;
+    Motor_Dir = dir;
+    SetDuty_Left(left);
+    SetDuty_Right(right);
+}
+
+// Timer A0 CCR0 task, applies the staged direction right after the
+// staged duty cycles are written at the period rollover
+static void Motor_Commit(void) {
+    if(!Motor_Running) return;
+    LEFT_DIR  = (Motor_Dir >> 4) & 1;
+    RIGHT_DIR = (Motor_Dir >> 5) & 1;
+    LEFT_PWM_ON  = 1;           //PWM back on the pins after a brake
+    RIGHT_PWM_ON = 1;
+    LEFT_EN  = 1;
+    RIGHT_EN = 1;
+    if(Ramp_Left.vel == Ramp_Left.target && Ramp_Right.vel == Ramp_Right.target
+       && !Ramp_Left.acc && !Ramp_Right.acc)
+    {
+        Motor_Running = 0;      //settled, the next command rearms
+    }
+}
+
+
+// stage a signed duty for each wheel through the ramp
+static void Motor_Command(int32_t left, int32_t right) {
+    long sr;
+    if(left  >  MAX_DUTY) left  =  MAX_DUTY;
+    if(left  < -MAX_DUTY) left  = -MAX_DUTY;
+    if(right >  MAX_DUTY) right =  MAX_DUTY;
+    if(right < -MAX_DUTY) right = -MAX_DUTY;
+
+    sr = StartCritical();       //the rollover can't split a command
+    Brake_Phase = 0;
+    Ramp_Left.target  = (int32_t)left*CONTROL_HZ;
+    Ramp_Right.target = (int32_t)right*CONTROL_HZ;
+    Motor_Target = ((left < 0) ? 0x10 : 0) | ((right < 0) ? 0x20 : 0);
+    if(!Motor_Running)
+    {
+        Motor_Running = 1;
+        Ramp_Advance();
+        TimerA0_Sync(&Motor_Commit);
+    }
+    EndCritical(sr);
+}
+
+
+
+/*
+  Motor_SetVelocity
+  ----------------------------------------------------------------------
+  Drive each wheel with a signed duty cycle, positive is forward and
+  negative is backward. The direction pins and both duty cycles are
+  staged, the duty cycles in the Timer A0 shadow registers, and applied
+  together at the start of the next PWM period by the CCR0 interrupt,
+  so the H-bridges never see a new direction with an old duty. With
+  Motor_SetRamp limits the wheels ramp toward the command over several
+  periods instead. A later call replaces the command. Each duty is
+  scaled for the battery voltage, see Motor_SetSupply. Assumes
+  Motor_Init() has been called.
+
+  Motor direction is negative logic where forward is a 0 on I/O pins.
+
+  Parameters:   1) speed of left motor as a Q15 fraction of full power(left/32768),
+                       magnitude is limited to 32767
+                2) speed of right motor as a Q15 fraction of full power(right/32768),
+                       magnitude is limited to 32767
+  Return value: none
+*/
+void Motor_SetVelocity(int16_t left, int16_t right) {
+    Speed_On = 0;               //open loop from here
+    Motor_Command((left*Supply_Scale) >> 12,(right*Supply_Scale) >> 12);
+}
+
+
+// one wheel's duty cycle from its speed error, held near where the ramp
+// has got to so the integral doesn't wind up while the ramp catches up
+static int32_t PI_Step(motor_pi* pi, const motor_ramp* ramp, int32_t speed) {
+    int32_t err = pi->target - speed;
+    int32_t ff  = (pi->target > 0) ? pi->deadband : (pi->target < 0) ? -pi->deadband : 0;
+    int32_t out, hi = MAX_DUTY, lo = -MAX_DUTY;
+    if(err >  SPEED_ERR) err =  SPEED_ERR;      //a bad tach reading can't overflow the products
+    if(err < -SPEED_ERR) err = -SPEED_ERR;
+    out = (((ff + pi->target*pi->ff/256)*Supply_Scale) >> 12) + (SPEED_KP*err + pi->integral)/256;
+    if(Ramp_Accel)
+    {
+        int32_t applied = ramp->vel/CONTROL_HZ;
+        if(applied + SPEED_SLEW < hi) hi = applied + SPEED_SLEW;
+        if(applied - SPEED_SLEW > lo) lo = applied - SPEED_SLEW;
+    }
+    if((out < hi || err < 0) && (out > lo || err > 0))
+    {
+        pi->integral += pi->ki*err;     //only wind up while the output has room
+        if(pi->integral >  SPEED_INT) pi->integral =  SPEED_INT;
+        if(pi->integral < -SPEED_INT) pi->integral = -SPEED_INT;
+    }
+    if(out > hi) out = hi;
+    if(out < lo) out = lo;
+    return out;
+}
+
+// speed loop step, every control period while Speed_On
+static void Speed_Loop(void) {
+    int32_t left, right;
+    Tach_Read(&left,&right);
+    Motor_Command(PI_Step(&PI_Left,&Ramp_Left,left),PI_Step(&PI_Right,&Ramp_Right,right));
+}
+
+
+/*
+  Motor_SetSpeed
+  ----------------------------------------------------------------------
+  Drive each wheel at a speed in mm/s, positive is forward. A PI loop
+  runs MOTOR_CONTROL_HZ times a second from Timer A2, reading the wheel speeds from
+  the tachometer and setting the duty cycles through the same ramp as
+  Motor_SetVelocity, with a feedforward of the duty each wheel needs
+  for the speed at the battery voltage, from the gain and deadband
+  in RCR_MotorID.h, fitted from a capture of each robot. The same command gives the same speed on
+  both wheels even when the motors differ. Any other motor command
+  turns the loop off. Assumes Motor_Init() and Tach_Init() have been
+  called.
+
+  Parameters:   1) speed of left wheel in mm/s,
+                       limited to MOTOR_LEFT_GAIN, its speed at full duty
+                2) speed of right wheel in mm/s,
+                       limited to MOTOR_RIGHT_GAIN
+  Return value: none
+*/
+void Motor_SetSpeed(int16_t left, int16_t right) {
+    long sr;
+    if(left  >  MOTOR_LEFT_GAIN)  left  =  MOTOR_LEFT_GAIN;     //keeps target*ff in range
+    if(left  < -MOTOR_LEFT_GAIN)  left  = -MOTOR_LEFT_GAIN;
+    if(right >  MOTOR_RIGHT_GAIN) right =  MOTOR_RIGHT_GAIN;
+    if(right < -MOTOR_RIGHT_GAIN) right = -MOTOR_RIGHT_GAIN;
+    sr = StartCritical();
+    PI_Left.target  = left;
+    PI_Right.target = right;
+    if(!Speed_On)
+    {
+        PI_Left.integral = PI_Right.integral = 0;
+        Speed_On = 1;
+        Speed_Loop();           //first command now, not at the next control period
+    }
+    Motor_Target = ((left < 0) ? 0x10 : 0) | ((right < 0) ? 0x20 : 0);
+    EndCritical(sr);
+}
+
+
+// pull both PWM pins low with the driver IC's awake
+static void Brake_Hold(void) {
+    LEFT_PWM  = 0;
+    RIGHT_PWM = 0;
+    LEFT_PWM_ON  = 0;           //pins are GPIO outputs until Motor_Commit
+    RIGHT_PWM_ON = 0;
+    LEFT_EN  = 1;
+    RIGHT_EN = 1;
+}
+
+// moves the brake from pulse to hold to coast, every control period
+static void Brake_Step(void) {
+    if(Brake_Periods && --Brake_Periods) return;
+    if(Brake_Phase == BRAKE_PULSE)
+    {
+        Brake_Hold();
+        Brake_Phase   = BRAKE_HOLD;
+        Brake_Periods = Brake_Hold_Periods;
+        return;
+    }
+    if(Brake_Hold_Periods)      //0 holds until the next command
+    {
+        LEFT_EN  = 0;           //done braking, let them coast
+        RIGHT_EN = 0;
+        Brake_Phase = 0;
+    }
+}
+
+// Timer A2 task every 1/CONTROL_HZ, steps the speed loop, the ramp
+// and the brake, masked so a bump can't stop the motors halfway through
+static void Motor_Control(void) {
+    long sr = StartCritical();
+    uint8_t running = Motor_Running;    //a command from the speed loop steps the ramp itself
+    if(Speed_On) Speed_Loop();
+    if(Brake_Phase) Brake_Step();
+    else if(running && Motor_Running)
+    {
+        Ramp_Advance();
+        TimerA0_Sync(&Motor_Commit);
+    }
+    EndCritical(sr);
+}
+
+/*
+  Motor_SetSupply
+  ----------------------------------------------------------------------
+  Give the motor layer the battery voltage so every duty cycle drives
+  the motors like it would on a MOTOR_NOMINAL_MV pack. Each command is
+  multiplied by MOTOR_NOMINAL_MV/mV, kept in Q12 so applying it is one
+  multiply and shift. The division happens here, once per reading.
+  The scale is kept between 0.5 and 1.5, and 0 mV turns it off. A
+  command already running keeps its old scale until the next command,
+  the speed loop picks it up within 10 ms.
+
+  Parameters:   1) battery voltage in mV, filtered(see Battery_Update)
+  Return value: none
+*/
+void Motor_SetSupply(uint32_t mV) {
+    int32_t scale = SUPPLY_ONE;
+    if(mV)
+    {
+        scale = (MOTOR_NOMINAL_MV << 12)/mV;
+        if(scale < SUPPLY_MIN) scale = SUPPLY_MIN;
+        if(scale > SUPPLY_MAX) scale = SUPPLY_MAX;
+    }
+    Supply_Scale = scale;
+}
+
+/*
+  Motor_Compensation
+  ----------------------------------------------------------------------
+  Gives the battery scale being applied to every duty cycle, for
+  telemetry.
+
+  Parameters:   none
+  Return value: scale in Q12, 4096 is 1.0
+*/
+uint16_t Motor_Compensation(void) {
+    return Supply_Scale;
+}
+
+/*
+  Motor_Brake
+  ----------------------------------------------------------------------
+  Stop the motors faster than Motor_Stop by shorting the windings. The
+  PWM pins are taken from Timer A0 and driven low with the driver IC's
+  awake, so both H-bridge outputs are pulled low and the back-EMF
+  brakes the motors. An optional reverse pulse first drives each wheel
+  against the direction it was running. After the brake time the
+  driver IC's are powered down and the motors coast like Motor_Stop.
+  The brake starts right away, skipping any ramp, and the next
+  Motor_SetVelocity or Motor_Stop ends it. Times are rounded up to
+  10 ms control periods. Assumes Motor_Init() has been called.
+
+  Parameters:   1) speed of the reverse pulse as a Q15 fraction of full power(pulseDuty/32768),
+                       must be <= 32767, 0 for no pulse
+                2) length of the reverse pulse in ms
+                3) time to brake in ms before powering down,
+                       0 brakes until the next command
+  Return value: none
+*/
+void Motor_Brake(uint16_t pulseDuty, uint16_t pulseMs, uint16_t brakeMs) {
+    long sr = StartCritical();
+    Motor_Running = 0;          //skip the ramp
+    Speed_On      = 0;
+    Ramp_Left.vel  = Ramp_Left.acc  = Ramp_Left.target  = 0;
+    Ramp_Right.vel = Ramp_Right.acc = Ramp_Right.target = 0;
+    Brake_Hold_Periods = (brakeMs + 9)/10;
+
+    if(pulseDuty && pulseMs)
+    {
+        LEFT_DIR  ^= 1;         //against the way each wheel was driven
+        RIGHT_DIR ^= 1;
+        TimerA0_Shadow(false);  //pulse starts now, not at the rollover
+        SetDuty_Left(Motor_Limit((pulseDuty*Supply_Scale) >> 12));
+        SetDuty_Right(Motor_Limit((pulseDuty*Supply_Scale) >> 12));
+        TimerA0_Shadow(true);
+        LEFT_PWM_ON  = 1;
+        RIGHT_PWM_ON = 1;
+        LEFT_EN  = 1;
+        RIGHT_EN = 1;
+        Brake_Phase   = BRAKE_PULSE;
+        Brake_Periods = (pulseMs + 9)/10;
+    }
+    else
+    {
+        Brake_Hold();
+        Brake_Phase   = BRAKE_HOLD;
+        Brake_Periods = Brake_Hold_Periods;
+    }
+    EndCritical(sr);
+}
+
+/*
+  Motor_Braking
+  ----------------------------------------------------------------------
+  Gives whether a Motor_Brake is still pulsing or braking. It turns
+  false once the brake time runs out and the motors coast, or when the
+  next command ends the brake early.
+
+  Parameters:   none
+  Return value: true while braking
+*/
+bool Motor_Braking(void) {
+    return Brake_Phase != 0;
 }
 
 
@@ -111,17 +589,14 @@ void Motor_Stop(void) {
 
   Motor direction is negative logic where forward is a 0 on I/O pins.
 
-  Parameters:   1) speed(in clk cycles) of left motor as percentage of period(leftDuty/15000),
-                       must be <= 14,998
-                2) speed(in clk cycles) of right motor as percentage of period(rightDuty/15000),
-                       must be <= 14,998
+  Parameters:   1) speed of left motor as a Q15 fraction of full power(leftDuty/32768),
+                       must be <= 32767
+                2) speed of right motor as a Q15 fraction of full power(rightDuty/32768),
+                       must be <= 32767
   Return value: none
 */
 void Motor_Forward(uint16_t leftDuty, uint16_t rightDuty) {
-    P3->OUT  |=  0xC0;
-    P5->OUT  &= ~0x30;
-    SetDuty_Left(leftDuty);
-    SetDuty_Right(rightDuty);
+    Motor_SetVelocity(Motor_Limit(leftDuty),Motor_Limit(rightDuty));
 }
 
 /*
@@ -133,18 +608,14 @@ void Motor_Forward(uint16_t leftDuty, uint16_t rightDuty) {
 
   Motor direction is negative logic where forward is a 0 on I/O pins.
 
-  Parameters:   1) speed(in clk cycles) of left motor as percentage of period(leftDuty/15000),
-                       must be <= 14,998
-                2) speed(in clk cycles) of right motor as percentage of period(rightDuty/15000),
-                       must be <= 14,998
+  Parameters:   1) speed of left motor as a Q15 fraction of full power(leftDuty/32768),
+                       must be <= 32767
+                2) speed of right motor as a Q15 fraction of full power(rightDuty/32768),
+                       must be <= 32767
   Return value: none
 */
 void Motor_Right(uint16_t leftDuty, uint16_t rightDuty) {
-    P3->OUT  |=  0xC0;
-    P5->OUT  &= ~0x10;
-    P5->OUT  |=  0x20;
-    SetDuty_Left(leftDuty);
-    SetDuty_Right(rightDuty);
+    Motor_SetVelocity(Motor_Limit(leftDuty),-Motor_Limit(rightDuty));
 }
 
 /*
@@ -156,18 +627,14 @@ void Motor_Right(uint16_t leftDuty, uint16_t rightDuty) {
 
   Motor direction is negative logic where forward is a 0 on I/O pins.
 
-  Parameters:   1) speed(in clk cycles) of left motor as percentage of period(leftDuty/15000),
-                       must be <= 14,998
-                2) speed(in clk cycles) of right motor as percentage of period(rightDuty/15000),
-                       must be <= 14,998
+  Parameters:   1) speed of left motor as a Q15 fraction of full power(leftDuty/32768),
+                       must be <= 32767
+                2) speed of right motor as a Q15 fraction of full power(rightDuty/32768),
+                       must be <= 32767
   Return value: none
 */
 void Motor_Left(uint16_t leftDuty, uint16_t rightDuty) {
-    P3->OUT  |=  0xC0;
-    P5->OUT  &= ~0x20;
-    P5->OUT  |=  0x10;
-    SetDuty_Left(leftDuty);
-    SetDuty_Right(rightDuty);
+    Motor_SetVelocity(-Motor_Limit(leftDuty),Motor_Limit(rightDuty));
 }
 
 /*
@@ -179,24 +646,22 @@ void Motor_Left(uint16_t leftDuty, uint16_t rightDuty) {
 
   Motor direction is negative logic where forward is a 0 on I/O pins.
 
-  Parameters:   1) speed(in clk cycles) of left motor as percentage of period(leftDuty/15000),
-                       must be <= 14,998
-                2) speed(in clk cycles) of right motor as percentage of period(rightDuty/15000),
-                       must be <= 14,998
+  Parameters:   1) speed of left motor as a Q15 fraction of full power(leftDuty/32768),
+                       must be <= 32767
+                2) speed of right motor as a Q15 fraction of full power(rightDuty/32768),
+                       must be <= 32767
   Return value: none
 */
 void Motor_Backward(uint16_t leftDuty, uint16_t rightDuty) {
-    P3->OUT  |= 0xC0;
-    P5->OUT  |= 0x30;
-    SetDuty_Left(leftDuty);
-    SetDuty_Right(rightDuty);
+    Motor_SetVelocity(-Motor_Limit(leftDuty),-Motor_Limit(rightDuty));
 }
 
 /*
   Motor_Direction
   ----------------------------------------------------------------------
-  Gives the current direction of the motors. Assumes Motor_Init()
-  has been called.
+  Gives the direction of the last command, which the motors have
+  or will have once they ramp to it. Assumes Motor_Init() has been
+  called.
 
   Motor direction is negative logic where forward is a 0 on I/O pins.
 
@@ -207,5 +672,5 @@ void Motor_Backward(uint16_t leftDuty, uint16_t rightDuty) {
                 0x10 is left
 */
 uint8_t Motor_Direction(void) {
-    return P5->OUT&0x30;
+    return Motor_Target;
 }
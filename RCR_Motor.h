@@ -48,7 +48,7 @@ policies, either expressed or implied, of the FreeBSD Project.
 #define RCR_MOTOR_H_
 
 
-//#include <stdbool.h>
+#include <stdbool.h>
 
 
 /*
@@ -67,6 +67,10 @@ policies, either expressed or implied, of the FreeBSD Project.
 #define RIGHTWARD    0x20
 #define LEFTWARD     0x10
 
+#define MAX_DUTY     32767      //full power, duty cycles are Q15 fractions of the PWM period
+#define MOTOR_CONTROL_HZ 100    //ramp, speed loop and brake steps per second
+#define MOTOR_NOMINAL_MV 7200   //battery voltage the duty cycles are tuned at, 6 NiMH cells
+
 
 /*
   Motor_Init
@@ -76,24 +80,156 @@ policies, either expressed or implied, of the FreeBSD Project.
   The motors are initially stopped, the driver IC's are initially powered
   down, and the PWM speed control is uninitialized.
 
-  Timer A0 is initialized for a 15000 clock cycle period that is 1/10
-  of the motor time constants of 100 ms.
+  Timer A0 is initialized for the PWM frequency given. Above 20 kHz the
+  motors can't be heard and the ripple on the supply is easier to
+  filter, 100 Hz is 1/10 of the motor time constants of 100 ms. Duty
+  cycles everywhere in this file are Q15 fractions of full power, so
+  the frequency can change without changing any of them. The ramp,
+  speed loop and brake run at MOTOR_CONTROL_HZ from Timer A2 whatever
+  the frequency, and stage their changes for the next PWM rollover.
 
-  Parameters:   none
+  Parameters:   1) PWM frequency in Hz, up to 120000
   Return value: none
 */
-void Motor_Init(void);
+void Motor_Init(uint32_t pwmHz);
 
 /*
   Motor_Stop
   ----------------------------------------------------------------------
-  Stop the motors by powering down the driver IC's.
+  Stop the motors by powering down the driver IC's. This is the
+  emergency stop, it skips any ramp from Motor_SetRamp and drops any
+  command still waiting for the PWM period. It runs with interrupts
+  masked, so the control period can't run the speed loop halfway
+  through and stage a new command that turns them back on.
 
   Parameters:   none
   Return value: none
 */
 void Motor_Stop(void);
 
+/*
+  Motor_SetVelocity
+  ----------------------------------------------------------------------
+  Drive each wheel with a signed duty cycle, positive is forward and
+  negative is backward. The direction pins and both duty cycles are
+  staged, the duty cycles in the Timer A0 shadow registers, and applied
+  together at the start of the next PWM period by the CCR0 interrupt,
+  so the H-bridges never see a new direction with an old duty. With
+  Motor_SetRamp limits the wheels ramp toward the command over several
+  periods instead. A later call replaces the command. Each duty is
+  scaled for the battery voltage, see Motor_SetSupply. Assumes
+  Motor_Init() has been called.
+
+  Motor direction is negative logic where forward is a 0 on I/O pins.
+
+  Parameters:   1) speed of left motor as a Q15 fraction of full power(left/32768),
+                       magnitude is limited to 32767
+                2) speed of right motor as a Q15 fraction of full power(right/32768),
+                       magnitude is limited to 32767
+  Return value: none
+*/
+void Motor_SetVelocity(int16_t left, int16_t right);
+
+/*
+  Motor_SetRamp
+  ----------------------------------------------------------------------
+  Limit how fast Motor_SetVelocity changes the duty cycles. Every
+  MOTOR_CONTROL_HZ period the velocity of each wheel moves toward its command, with the
+  acceleration changing by no more than the jerk limit and easing off
+  so the command is reached without overshoot. A reversal ramps down
+  through zero before the direction pin changes. Motor_Stop skips the
+  ramp and stops right away.
+
+  Parameters:   1) max acceleration in Q15 duty per second,
+                       0 steps straight to each command
+                2) max jerk in Q15 duty per second per second,
+                       0 lets the acceleration step
+  Return value: none
+*/
+void Motor_SetRamp(uint32_t accel, uint32_t jerk);
+
+/*
+  Motor_SetSpeed
+  ----------------------------------------------------------------------
+  Drive each wheel at a speed in mm/s, positive is forward. A PI loop
+  runs MOTOR_CONTROL_HZ times a second from Timer A2, reading the wheel speeds from
+  the tachometer and setting the duty cycles through the same ramp as
+  Motor_SetVelocity, with a feedforward of the duty each wheel needs
+  for the speed at the battery voltage, from the gain and deadband
+  in RCR_MotorID.h, fitted from a capture of each robot. The same command gives the same speed on
+  both wheels even when the motors differ. Any other motor command
+  turns the loop off. Assumes Motor_Init() and Tach_Init() have been
+  called.
+
+  Parameters:   1) speed of left wheel in mm/s,
+                       limited to MOTOR_LEFT_GAIN, its speed at full duty
+                2) speed of right wheel in mm/s,
+                       limited to MOTOR_RIGHT_GAIN
+  Return value: none
+*/
+void Motor_SetSpeed(int16_t left, int16_t right);
+
+/*
+  Motor_SetSupply
+  ----------------------------------------------------------------------
+  Give the motor layer the battery voltage so every duty cycle drives
+  the motors like it would on a MOTOR_NOMINAL_MV pack. Each command is
+  multiplied by MOTOR_NOMINAL_MV/mV, kept in Q12 so applying it is one
+  multiply and shift. The division happens here, once per reading.
+  The scale is kept between 0.5 and 1.5, and 0 mV turns it off. A
+  command already running keeps its old scale until the next command,
+  the speed loop picks it up within 10 ms.
+
+  Parameters:   1) battery voltage in mV, filtered(see Battery_Update)
+  Return value: none
+*/
+void Motor_SetSupply(uint32_t mV);
+
+/*
+  Motor_Compensation
+  ----------------------------------------------------------------------
+  Gives the battery scale being applied to every duty cycle, for
+  telemetry.
+
+  Parameters:   none
+  Return value: scale in Q12, 4096 is 1.0
+*/
+uint16_t Motor_Compensation(void);
+
+/*
+  Motor_Brake
+  ----------------------------------------------------------------------
+  Stop the motors faster than Motor_Stop by shorting the windings. The
+  PWM pins are taken from Timer A0 and driven low with the driver IC's
+  awake, so both H-bridge outputs are pulled low and the back-EMF
+  brakes the motors. An optional reverse pulse first drives each wheel
+  against the direction it was running. After the brake time the
+  driver IC's are powered down and the motors coast like Motor_Stop.
+  The brake starts right away, skipping any ramp, and the next
+  Motor_SetVelocity or Motor_Stop ends it. Times are rounded up to
+  10 ms control periods. Assumes Motor_Init() has been called.
+
+  Parameters:   1) speed of the reverse pulse as a Q15 fraction of full power(pulseDuty/32768),
+                       must be <= 32767, 0 for no pulse
+                2) length of the reverse pulse in ms
+                3) time to brake in ms before powering down,
+                       0 brakes until the next command
+  Return value: none
+*/
+void Motor_Brake(uint16_t pulseDuty, uint16_t pulseMs, uint16_t brakeMs);
+
+/*
+  Motor_Braking
+  ----------------------------------------------------------------------
+  Gives whether a Motor_Brake is still pulsing or braking. It turns
+  false once the brake time runs out and the motors coast, or when the
+  next command ends the brake early.
+
+  Parameters:   none
+  Return value: true while braking
+*/
+bool Motor_Braking(void);
+
 /*
   Motor_Forward
   ----------------------------------------------------------------------
@@ -103,10 +239,10 @@ void Motor_Stop(void);
 
   Motor direction is negative logic where forward is a 0 on I/O pins.
 
-  Parameters:   1) speed(in clk cycles) of left motor as percentage of period(leftDuty/15000),
-                       must be <= 14,998
-                2) speed(in clk cycles) of right motor as percentage of period(rightDuty/15000),
-                       must be <= 14,998
+  Parameters:   1) speed of left motor as a Q15 fraction of full power(leftDuty/32768),
+                       must be <= 32767
+                2) speed of right motor as a Q15 fraction of full power(rightDuty/32768),
+                       must be <= 32767
   Return value: none
 */
 void Motor_Forward(uint16_t leftDuty, uint16_t rightDuty);
@@ -120,10 +256,10 @@ void Motor_Forward(uint16_t leftDuty, uint16_t rightDuty);
 
   Motor direction is negative logic where forward is a 0 on I/O pins.
 
-  Parameters:   1) speed(in clk cycles) of left motor as percentage of period(leftDuty/15000),
-                       must be <= 14,998
-                2) speed(in clk cycles) of right motor as percentage of period(rightDuty/15000),
-                       must be <= 14,998
+  Parameters:   1) speed of left motor as a Q15 fraction of full power(leftDuty/32768),
+                       must be <= 32767
+                2) speed of right motor as a Q15 fraction of full power(rightDuty/32768),
+                       must be <= 32767
   Return value: none
 */
 void Motor_Right(uint16_t leftDuty, uint16_t rightDuty);
@@ -137,10 +273,10 @@ void Motor_Right(uint16_t leftDuty, uint16_t rightDuty);
 
   Motor direction is negative logic where forward is a 0 on I/O pins.
 
-  Parameters:   1) speed(in clk cycles) of left motor as percentage of period(leftDuty/15000),
-                       must be <= 14,998
-                2) speed(in clk cycles) of right motor as percentage of period(rightDuty/15000),
-                       must be <= 14,998
+  Parameters:   1) speed of left motor as a Q15 fraction of full power(leftDuty/32768),
+                       must be <= 32767
+                2) speed of right motor as a Q15 fraction of full power(rightDuty/32768),
+                       must be <= 32767
   Return value: none
 */
 void Motor_Left(uint16_t leftDuty, uint16_t rightDuty);
@@ -154,10 +290,10 @@ void Motor_Left(uint16_t leftDuty, uint16_t rightDuty);
 
   Motor direction is negative logic where forward is a 0 on I/O pins.
 
-  Parameters:   1) speed(in clk cycles) of left motor as percentage of period(leftDuty/15000),
-                       must be <= 14,998
-                2) speed(in clk cycles) of right motor as percentage of period(rightDuty/15000),
-                       must be <= 14,998
+  Parameters:   1) speed of left motor as a Q15 fraction of full power(leftDuty/32768),
+                       must be <= 32767
+                2) speed of right motor as a Q15 fraction of full power(rightDuty/32768),
+                       must be <= 32767
   Return value: none
 */
 void Motor_Backward(uint16_t leftDuty, uint16_t rightDuty);
@@ -165,8 +301,9 @@ void Motor_Backward(uint16_t leftDuty, uint16_t rightDuty);
 /*
   Motor_Direction
   ----------------------------------------------------------------------
-  Gives the current direction of the motors. Assumes Motor_Init()
-  has been called.
+  Gives the direction of the last command, which the motors have
+  or will have once they ramp to it. Assumes Motor_Init() has been
+  called.
 
   Motor direction is negative logic where forward is a 0 on I/O pins.
 
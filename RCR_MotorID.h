@@ -0,0 +1,24 @@
+// RCR_MotorID.h
+// Compatible with MSP432
+// Placeholder until tools/fit_motor.c is run on a capture
+
+// No robot has been captured yet, so these are not
+// measured. They give back the hand-tuned speed loop
+// from before the motors were modeled, to rounding:
+// GAIN 596 makes SPEED_FF 55 Q15 duty per mm/s with no
+// deadband. There is no TAU_MS until one is measured, so
+// RCR_Motor.c uses its hand-tuned integral gain instead.
+// Run RCR_SysID.c on the robot and replace this file with
+//   ./fit_motor capture.txt > RCR_MotorID.h
+// Do not fit ./robot_sim sysid for it. The simulator's
+// motors and deadbands are made up.
+
+#ifndef RCR_MOTORID_H_
+#define RCR_MOTORID_H_
+
+#define MOTOR_LEFT_GAIN        596     //hand-tuned, not measured
+#define MOTOR_LEFT_DEADBAND      0
+#define MOTOR_RIGHT_GAIN       596
+#define MOTOR_RIGHT_DEADBAND     0
+
+#endif /* RCR_MOTORID_H_ */
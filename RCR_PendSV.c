@@ -0,0 +1,94 @@
+// RCR_PendSV.c
+// Compatible with MSP432
+// Abhi Kallur
+
+// Runs the slow half of an interrupt's work at the
+// lowest priority through PendSV. The interrupt
+// only grabs its data and pends the task, and the
+// task runs as soon as no other interrupt is
+// active. Each stage is timed with SysTick, so how
+// long the interrupt holds off the others and how
+// late the task starts can both be read back.
+
+
+#include <stdint.h>
+#include "msp.h"
+#include "RCR_PendSV.h"
+
+#define PENDSVSET   0x10000000      //ICSR bit that pends PendSV
+
+static void (*PendSVTask)(void);    // user task run at the lowest priority
+static volatile uint8_t  PendSV_Waiting;
+static volatile uint32_t PendSV_Time;   //SysTick->VAL at the pend
+static pendsv_stats PendSV_Stat;
+
+
+/*
+  PendSV_Init
+  ----------------------------------------------------------------------
+  Set PendSV to priority 7, below every other interrupt, and give it a
+  user task. Stages are timed with the SysTick counter, so
+  SysTick_Init() must have been called.
+
+  Parameters:   1) function pointer to user task run by PendSV
+  Return value: none
+*/
+void PendSV_Init(void(*task)(void)) {
+    PendSVTask = task;
+    PendSV_Waiting = 0;
+    PendSV_Stat.runs = PendSV_Stat.merged = 0;
+    PendSV_Stat.capture = PendSV_Stat.latency = PendSV_Stat.run = 0;
+    SCB->SHP[10] = 0xE0;            //priority 7, PendSV is system handler 14
+}
+
+/*
+  PendSV_Pend
+  ----------------------------------------------------------------------
+  Ask for the user task to run once the interrupts running now are
+  done. Pending again before it runs still runs it once, and is
+  counted as merged. Called from the top half of an interrupt.
+
+  Parameters:   1) SysTick->VAL read when the top half started
+  Return value: none
+*/
+void PendSV_Pend(uint32_t start) {
+    uint32_t now = SysTick->VAL;
+    uint32_t capture = (start - now) & 0x00FFFFFF;  //SysTick counts down
+    if(capture > PendSV_Stat.capture) PendSV_Stat.capture = capture;
+    if(PendSV_Waiting) PendSV_Stat.merged++;
+    PendSV_Waiting = 1;
+    PendSV_Time = now;
+    SCB->ICSR = PENDSVSET;          //writing 0 to the other bits does nothing
+}
+
+/*
+  PendSV_Report
+  ----------------------------------------------------------------------
+  Gives the longest time of each stage since PendSV_Init.
+
+  Parameters:   none
+  Return value: the counters
+*/
+const pendsv_stats* PendSV_Report(void) {
+    return &PendSV_Stat;
+}
+
+/*
+  PendSV_Handler
+  ----------------------------------------------------------------------
+  Runs the user task once for every pend, or once for several pends
+  made before it got to run.
+
+  Parameters:   none
+  Return value: none
+*/
+void PendSV_Handler(void) {
+    uint32_t start = SysTick->VAL, cycles;
+    cycles = (PendSV_Time - start) & 0x00FFFFFF;
+    if(cycles > PendSV_Stat.latency) PendSV_Stat.latency = cycles;
+    PendSV_Waiting = 0;             //a pend from here on runs the task again
+    (*PendSVTask)();
+    cycles = (start - SysTick->VAL) & 0x00FFFFFF;
+    if(cycles > PendSV_Stat.run) PendSV_Stat.run = cycles;
+    PendSV_Stat.runs++;
+}
@@ -0,0 +1,65 @@
+// RCR_PendSV.h
+// Compatible with MSP432
+// Abhi Kallur
+
+// Runs the slow half of an interrupt's work at the
+// lowest priority through PendSV. The interrupt
+// only grabs its data and pends the task, and the
+// task runs as soon as no other interrupt is
+// active. Each stage is timed with SysTick, so how
+// long the interrupt holds off the others and how
+// late the task starts can both be read back.
+
+#ifndef RCR_PENDSV_H_
+#define RCR_PENDSV_H_
+
+
+// longest time of each stage in bus cycles, and how often the task fell behind
+struct PendSV_Stats
+{
+    uint32_t runs;
+    uint32_t merged;            // pends made while the last one was still waiting
+    uint32_t capture;           // top half, from its start to the pend
+    uint32_t latency;           // from the pend to the task starting
+    uint32_t run;               // task itself, including any interrupts it let in
+};
+
+typedef struct PendSV_Stats pendsv_stats;
+
+
+/*
+  PendSV_Init
+  ----------------------------------------------------------------------
+  Set PendSV to priority 7, below every other interrupt, and give it a
+  user task. Stages are timed with the SysTick counter, so
+  SysTick_Init() must have been called.
+
+  Parameters:   1) function pointer to user task run by PendSV
+  Return value: none
+*/
+void PendSV_Init(void(*task)(void));
+
+/*
+  PendSV_Pend
+  ----------------------------------------------------------------------
+  Ask for the user task to run once the interrupts running now are
+  done. Pending again before it runs still runs it once, and is
+  counted as merged. Called from the top half of an interrupt.
+
+  Parameters:   1) SysTick->VAL read when the top half started
+  Return value: none
+*/
+void PendSV_Pend(uint32_t start);
+
+/*
+  PendSV_Report
+  ----------------------------------------------------------------------
+  Gives the longest time of each stage since PendSV_Init.
+
+  Parameters:   none
+  Return value: the counters
+*/
+const pendsv_stats* PendSV_Report(void);
+
+
+#endif /* RCR_PENDSV_H_ */
@@ -0,0 +1,29 @@
+// RCR_Pin.h
+// Compatible with MSP432
+// Abhi Kallur
+
+// Single bit access to GPIO pins through the
+// peripheral bit-band alias. A write is one store
+// to the pin's own word, not a read-modify-write
+// of the whole port, so an interrupt that writes
+// another pin of the port in between can't be
+// undone by it. On the host build msp.h maps the
+// alias onto the simulated register block, so the
+// same code runs there unchanged.
+
+#ifndef RCR_PIN_H_
+#define RCR_PIN_H_
+
+#include "msp.h"
+
+// a pin's output, read or written as 0 or 1
+#define PIN_OUT(port, bit)   BITBAND_PERI((port)->OUT,bit)
+
+// a pin's primary function select, 1 gives it to the peripheral
+#define PIN_SEL0(port, bit)  BITBAND_PERI((port)->SEL0,bit)
+
+// a pin's input, read only
+#define PIN_IN(port, bit)    BITBAND_PERI((port)->IN,bit)
+
+
+#endif /* RCR_PIN_H_ */
@@ -0,0 +1,98 @@
+// RCR_Ring.c
+// Compatible with MSP432
+// Abhi Kallur
+
+// Lock-free queue of fixed-size records from one
+// producer to one consumer, like an ISR handing
+// samples to the main loop. Neither side masks
+// interrupts. The producer only writes head and
+// the consumer only writes tail, each a single
+// aligned 32-bit store, so either can be preempted
+// by the other anywhere. When the ring is full the
+// new record is dropped and counted, so the
+// consumer sees every record it gets in order and
+// knows how many it missed.
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "msp.h"
+#include "RCR_Ring.h"
+
+
+/*
+  Ring_Init
+  ----------------------------------------------------------------------
+  Start a ring empty over a buffer. Call it before either side uses
+  the ring.
+
+  Parameters:   1) ring to set up
+                2) buffer for count records, must stay valid
+                3) bytes in a record
+                4) records the buffer holds, a power of 2
+  Return value: none
+*/
+void Ring_Init(ring* r, void* buf, uint16_t size, uint16_t count) {
+    r->buf  = buf;
+    r->size = size;
+    r->mask = count - 1;
+    r->head = 0;
+    r->tail = 0;
+    r->overruns = 0;
+}
+
+/*
+  Ring_Put
+  ----------------------------------------------------------------------
+  Copy a record in, producer side only. The record is only seen by
+  the consumer once it is all there.
+
+  Parameters:   1) ring
+                2) record to copy, size bytes
+  Return value: true if added, false if the ring was full and the
+                    record was dropped and counted
+*/
+bool Ring_Put(ring* r, const void* rec) {
+    uint32_t head = r->head;
+    if(head - r->tail > r->mask)        //full, indexes run freely and wrap together
+    {
+        r->overruns++;
+        return false;
+    }
+    memcpy(r->buf + (head & r->mask)*r->size,rec,r->size);
+    __DMB();                            //record is written before head says so
+    r->head = head + 1;
+    return true;
+}
+
+/*
+  Ring_Get
+  ----------------------------------------------------------------------
+  Copy the oldest record out, consumer side only.
+
+  Parameters:   1) ring
+                2) where to copy the record, size bytes
+  Return value: true if a record was copied, false if the ring was empty
+*/
+bool Ring_Get(ring* r, void* rec) {
+    uint32_t tail = r->tail;
+    if(tail == r->head) return false;
+    __DMB();                            //head is read before the record
+    memcpy(rec,r->buf + (tail & r->mask)*r->size,r->size);
+    __DMB();                            //record is read before the slot is given back
+    r->tail = tail + 1;
+    return true;
+}
+
+/*
+  Ring_Overruns
+  ----------------------------------------------------------------------
+  Gives the records dropped since Ring_Init because the ring was full.
+
+  Parameters:   1) ring
+  Return value: records dropped
+*/
+uint32_t Ring_Overruns(const ring* r) {
+    return r->overruns;
+}
@@ -0,0 +1,85 @@
+// RCR_Ring.h
+// Compatible with MSP432
+// Abhi Kallur
+
+// Lock-free queue of fixed-size records from one
+// producer to one consumer, like an ISR handing
+// samples to the main loop. Neither side masks
+// interrupts. The producer only writes head and
+// the consumer only writes tail, each a single
+// aligned 32-bit store, so either can be preempted
+// by the other anywhere. When the ring is full the
+// new record is dropped and counted, so the
+// consumer sees every record it gets in order and
+// knows how many it missed.
+
+#ifndef RCR_RING_H_
+#define RCR_RING_H_
+
+#include <stdbool.h>
+
+
+// a ring over a buffer of records, set up by Ring_Init
+struct Ring
+{
+    uint8_t* buf;               // records, count*size bytes
+    uint16_t size;              // bytes in a record
+    uint16_t mask;              // count - 1, count is a power of 2
+    volatile uint32_t head;     // records put, written by the producer
+    volatile uint32_t tail;     // records taken, written by the consumer
+    volatile uint32_t overruns; // records dropped on a full ring, written by the producer
+};
+
+typedef struct Ring ring;
+
+
+/*
+  Ring_Init
+  ----------------------------------------------------------------------
+  Start a ring empty over a buffer. Call it before either side uses
+  the ring.
+
+  Parameters:   1) ring to set up
+                2) buffer for count records, must stay valid
+                3) bytes in a record
+                4) records the buffer holds, a power of 2
+  Return value: none
+*/
+void Ring_Init(ring* r, void* buf, uint16_t size, uint16_t count);
+
+/*
+  Ring_Put
+  ----------------------------------------------------------------------
+  Copy a record in, producer side only. The record is only seen by
+  the consumer once it is all there.
+
+  Parameters:   1) ring
+                2) record to copy, size bytes
+  Return value: true if added, false if the ring was full and the
+                    record was dropped and counted
+*/
+bool Ring_Put(ring* r, const void* rec);
+
+/*
+  Ring_Get
+  ----------------------------------------------------------------------
+  Copy the oldest record out, consumer side only.
+
+  Parameters:   1) ring
+                2) where to copy the record, size bytes
+  Return value: true if a record was copied, false if the ring was empty
+*/
+bool Ring_Get(ring* r, void* rec);
+
+/*
+  Ring_Overruns
+  ----------------------------------------------------------------------
+  Gives the records dropped since Ring_Init because the ring was full.
+
+  Parameters:   1) ring
+  Return value: records dropped
+*/
+uint32_t Ring_Overruns(const ring* r);
+
+
+#endif /* RCR_RING_H_ */
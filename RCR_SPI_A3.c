@@ -62,7 +62,7 @@ void SPI_A3_Init(void) {
   Return value: none
 */
 void SPI_A3_Tx(uint8_t data) {
-    while(EUSCI_A3->STATW&0x0001 == 1) {}   //wait for SPI to be ready and then tx
+    while((EUSCI_A3->STATW&0x0001) == 1) {}   //wait for SPI to be ready and then tx
     EUSCI_A3->TXBUF = data;
     //add SysTick check for a timeout in while loop
 }
@@ -0,0 +1,229 @@
+// RCR_Sched.c
+// Compatible with MSP432
+// Abhi Kallur
+
+// Runs the main loop's periodic work from a table
+// of tasks instead of a counter for each one. An
+// interrupt calls Sched_Tick at a steady rate and
+// the main loop calls Sched_Run, which runs every
+// task that is due, highest priority first, one at
+// a time to completion. Each run is timed with
+// SysTick and checked against the task's budget.
+// With nothing to run, Sched_Sleep puts the CPU
+// to sleep until the next interrupt.
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "msp.h"
+#include "CortexM.h"
+#include "RCR_Sched.h"
+
+static const sched_task* Sched_Table;
+static uint8_t  Sched_Count;
+static uint8_t  Sched_Order[SCHED_TASKS];   //table indexes, highest priority first
+static uint16_t Sched_Wait[SCHED_TASKS];    //ticks until each task's next release
+static uint8_t  Sched_Ready[SCHED_TASKS];   //released and not run yet
+static sched_stats Sched_Stat[SCHED_TASKS];
+
+static volatile uint32_t Sched_Now;         //ticks counted by Sched_Tick
+static uint32_t Sched_Done;                 //ticks released by Sched_Run
+static uint64_t Sched_Asleep;               //bus cycles in Sched_Sleep
+
+
+// release the tasks due at one tick
+static void Sched_Release(void) {
+    uint8_t i;
+    for(i = 0; i < Sched_Count; i++)
+    {
+        if(Sched_Wait[i])
+        {
+            Sched_Wait[i]--;
+            continue;
+        }
+        if(Sched_Ready[i]) Sched_Stat[i].missed++;
+        Sched_Ready[i] = 1;
+        Sched_Wait[i]  = Sched_Table[i].period - 1;
+    }
+}
+
+
+/*
+  Sched_Init
+  ----------------------------------------------------------------------
+  Start a task table with no ticks counted and nothing released. Runs
+  are timed with the SysTick counter, so SysTick_Init() must have been
+  called and a run has to take less than 2^24 bus cycles, 349 ms at
+  48 MHz.
+
+  Parameters:   1) tasks, must stay valid while the scheduler runs
+                2) number of tasks, up to SCHED_TASKS
+  Return value: none
+*/
+void Sched_Init(const sched_task* tasks, uint8_t count) {
+    uint8_t i, j;
+    if(count > SCHED_TASKS) count = SCHED_TASKS;
+    Sched_Table = tasks;
+    Sched_Count = count;
+    for(i = 0; i < count; i++)
+    {
+        Sched_Wait[i]  = tasks[i].phase;
+        Sched_Ready[i] = 0;
+        Sched_Stat[i].runs = Sched_Stat[i].overruns = 0;
+        Sched_Stat[i].missed = Sched_Stat[i].max_cycles = 0;
+        for(j = i; j && tasks[Sched_Order[j-1]].priority > tasks[i].priority; j--)
+        {
+            Sched_Order[j] = Sched_Order[j-1];   //insertion sort, ties keep table order
+        }
+        Sched_Order[j] = i;
+    }
+    Sched_Now  = 0;
+    Sched_Done = 0;
+    Sched_Asleep = 0;
+}
+
+/*
+  Sched_Tick
+  ----------------------------------------------------------------------
+  Count one tick. Call it from the interrupt that sets the rate, or
+  from a loop on the host to drive the scheduler with a virtual clock.
+  Nothing runs here, tasks are released by the next Sched_Run.
+
+  Parameters:   none
+  Return value: none
+*/
+void Sched_Tick(void) {
+    Sched_Now++;
+}
+
+/*
+  Sched_Run
+  ----------------------------------------------------------------------
+  Release the tasks due at every tick since the last call, then run
+  the highest priority one that is waiting. A task released again
+  before it ran counts as missed. Call it over and over from the main
+  loop. Between two runs it picks up new ticks, so a higher priority
+  task released meanwhile goes ahead of lower ones still waiting.
+
+  Parameters:   none
+  Return value: true if a task ran, false if none was waiting
+*/
+bool Sched_Run(void) {
+    uint32_t start, cycles;
+    sched_stats* s;
+    uint8_t i, k;
+
+    while(Sched_Done != Sched_Now)
+    {
+        Sched_Release();
+        Sched_Done++;
+    }
+    for(k = 0; k < Sched_Count; k++)
+    {
+        i = Sched_Order[k];
+        if(Sched_Ready[i]) break;
+    }
+    if(k == Sched_Count) return false;
+
+    Sched_Ready[i] = 0;
+    start = SysTick->VAL;
+    (*Sched_Table[i].task)();
+    cycles = (start - SysTick->VAL) & 0x00FFFFFF;   //SysTick counts down
+
+    s = &Sched_Stat[i];
+    s->runs++;
+    if(cycles > s->max_cycles) s->max_cycles = cycles;
+    if(Sched_Table[i].budget && cycles > Sched_Table[i].budget) s->overruns++;
+    return true;
+}
+
+/*
+  Sched_Ticks
+  ----------------------------------------------------------------------
+  Gives the ticks counted since Sched_Init.
+
+  Parameters:   none
+  Return value: ticks
+*/
+uint32_t Sched_Ticks(void) {
+    return Sched_Now;
+}
+
+/*
+  Sched_Report
+  ----------------------------------------------------------------------
+  Gives what a task has done since Sched_Init.
+
+  Parameters:   1) index of the task in the table
+  Return value: its counters, null past the end of the table
+*/
+const sched_stats* Sched_Report(uint8_t i) {
+    if(i >= Sched_Count) return 0;
+    return &Sched_Stat[i];
+}
+
+/*
+  Sched_Overruns
+  ----------------------------------------------------------------------
+  Gives the overruns and missed releases of every task added up, 0
+  while the table keeps to its budgets.
+
+  Parameters:   none
+  Return value: overruns plus missed releases
+*/
+uint32_t Sched_Overruns(void) {
+    uint32_t sum = 0;
+    uint8_t i;
+    for(i = 0; i < Sched_Count; i++) sum += Sched_Stat[i].overruns + Sched_Stat[i].missed;
+    return sum;
+}
+
+/*
+  Sched_Sleep
+  ----------------------------------------------------------------------
+  Sleep in LPM0 until the next interrupt if no task is waiting and no
+  tick has come in since the last Sched_Run. Interrupts are masked
+  from the check until after the WFI. An interrupt in between stays
+  pending, and a pending interrupt wakes WFI even while masked, so it
+  can't be slept through. It runs once they are unmasked on the way
+  out. The time asleep is counted with SysTick. SLEEPDEEP must be
+  clear, as it is out of reset, or this is LPM3 instead.
+
+  Parameters:   none
+  Return value: none
+*/
+void Sched_Sleep(void) {
+    uint32_t start;
+    uint8_t i;
+    long sr = StartCritical();
+    if(Sched_Done != Sched_Now)
+    {
+        EndCritical(sr);                    //a tick came in, Sched_Run has work
+        return;
+    }
+    for(i = 0; i < Sched_Count; i++)
+    {
+        if(Sched_Ready[i])
+        {
+            EndCritical(sr);
+            return;
+        }
+    }
+    start = SysTick->VAL;
+    WaitForInterrupt();                     //wakes on a pending interrupt, it runs at EndCritical
+    Sched_Asleep += (start - SysTick->VAL) & 0x00FFFFFF;
+    EndCritical(sr);
+}
+
+/*
+  Sched_Idle
+  ----------------------------------------------------------------------
+  Gives the bus cycles spent asleep in Sched_Sleep since Sched_Init.
+  Two readings a known time apart give the CPU load between them.
+
+  Parameters:   none
+  Return value: cycles asleep
+*/
+uint64_t Sched_Idle(void) {
+    return Sched_Asleep;
+}
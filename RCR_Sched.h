@@ -0,0 +1,147 @@
+// RCR_Sched.h
+// Compatible with MSP432
+// Abhi Kallur
+
+// Runs the main loop's periodic work from a table
+// of tasks instead of a counter for each one. An
+// interrupt calls Sched_Tick at a steady rate and
+// the main loop calls Sched_Run, which runs every
+// task that is due, highest priority first, one at
+// a time to completion. Each run is timed with
+// SysTick and checked against the task's budget.
+// With nothing to run, Sched_Sleep puts the CPU
+// to sleep until the next interrupt.
+
+#ifndef RCR_SCHED_H_
+#define RCR_SCHED_H_
+
+#include <stdbool.h>
+
+#define SCHED_TASKS    8        //most tasks in a table
+
+
+// one periodic task, released every period ticks starting at its phase
+struct Sched_Task
+{
+    const char* name;           // for reports
+    void      (*task)(void);    // runs to completion in main context
+    uint16_t    period;         // ticks between releases, at least 1
+    uint16_t    phase;          // ticks before the first release, spreads tasks with the same period
+    uint8_t     priority;       // 0 runs first when several are due
+    uint32_t    budget;         // worst case bus cycles, a longer run is an overrun
+};
+
+typedef struct Sched_Task sched_task;
+
+// what a task has done since Sched_Init
+struct Sched_Stats
+{
+    uint32_t runs;
+    uint32_t overruns;          // runs longer than the budget
+    uint32_t missed;            // releases dropped since the last one hadn't run yet
+    uint32_t max_cycles;        // longest run in bus cycles
+};
+
+typedef struct Sched_Stats sched_stats;
+
+
+/*
+  Sched_Init
+  ----------------------------------------------------------------------
+  Start a task table with no ticks counted and nothing released. Runs
+  are timed with the SysTick counter, so SysTick_Init() must have been
+  called and a run has to take less than 2^24 bus cycles, 349 ms at
+  48 MHz.
+
+  Parameters:   1) tasks, must stay valid while the scheduler runs
+                2) number of tasks, up to SCHED_TASKS
+  Return value: none
+*/
+void Sched_Init(const sched_task* tasks, uint8_t count);
+
+/*
+  Sched_Tick
+  ----------------------------------------------------------------------
+  Count one tick. Call it from the interrupt that sets the rate, or
+  from a loop on the host to drive the scheduler with a virtual clock.
+  Nothing runs here, tasks are released by the next Sched_Run.
+
+  Parameters:   none
+  Return value: none
+*/
+void Sched_Tick(void);
+
+/*
+  Sched_Run
+  ----------------------------------------------------------------------
+  Release the tasks due at every tick since the last call, then run
+  the highest priority one that is waiting. A task released again
+  before it ran counts as missed. Call it over and over from the main
+  loop. Between two runs it picks up new ticks, so a higher priority
+  task released meanwhile goes ahead of lower ones still waiting.
+
+  Parameters:   none
+  Return value: true if a task ran, false if none was waiting
+*/
+bool Sched_Run(void);
+
+/*
+  Sched_Ticks
+  ----------------------------------------------------------------------
+  Gives the ticks counted since Sched_Init.
+
+  Parameters:   none
+  Return value: ticks
+*/
+uint32_t Sched_Ticks(void);
+
+/*
+  Sched_Report
+  ----------------------------------------------------------------------
+  Gives what a task has done since Sched_Init.
+
+  Parameters:   1) index of the task in the table
+  Return value: its counters, null past the end of the table
+*/
+const sched_stats* Sched_Report(uint8_t i);
+
+/*
+  Sched_Overruns
+  ----------------------------------------------------------------------
+  Gives the overruns and missed releases of every task added up, 0
+  while the table keeps to its budgets.
+
+  Parameters:   none
+  Return value: overruns plus missed releases
+*/
+uint32_t Sched_Overruns(void);
+
+/*
+  Sched_Sleep
+  ----------------------------------------------------------------------
+  Sleep in LPM0 until the next interrupt if no task is waiting and no
+  tick has come in since the last Sched_Run. Interrupts are masked
+  from the check until after the WFI. An interrupt in between stays
+  pending, and a pending interrupt wakes WFI even while masked, so it
+  can't be slept through. It runs once they are unmasked on the way
+  out. The time asleep is counted with SysTick. SLEEPDEEP must be
+  clear, as it is out of reset, or this is LPM3 instead.
+
+  Parameters:   none
+  Return value: none
+*/
+void Sched_Sleep(void);
+
+/*
+  Sched_Idle
+  ----------------------------------------------------------------------
+  Gives the bus cycles spent asleep in Sched_Sleep since Sched_Init.
+  Two readings a known time apart give the CPU load between them.
+
+  Parameters:   none
+  Return value: cycles asleep
+*/
+uint64_t Sched_Idle(void);
+
+
+#endif /* RCR_SCHED_H_ */
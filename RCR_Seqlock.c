@@ -0,0 +1,80 @@
+// RCR_Seqlock.c
+// Compatible with MSP432
+// Abhi Kallur
+
+// Shares the newest copy of a small record from one
+// writer, like an ISR, with readers in lower priority
+// code. The writer makes the sequence count odd,
+// copies the record in and makes it even again. A
+// reader copies the record out between two reads of
+// the count and tries again if it changed or was odd,
+// so it always ends up with one whole record. Nobody
+// masks interrupts and the writer never waits.
+
+
+#include <stdint.h>
+#include <string.h>
+#include "msp.h"
+#include "RCR_Seqlock.h"
+
+
+/*
+  Seqlock_Init
+  ----------------------------------------------------------------------
+  Put a record behind a sequence count. The record's contents are the
+  first copy readers get.
+
+  Parameters:   1) seqlock to set up
+                2) record, must stay valid
+                3) bytes in the record
+  Return value: none
+*/
+void Seqlock_Init(seqlock* s, void* data, uint16_t size) {
+    s->data = data;
+    s->size = size;
+    s->seq  = 0;
+    s->retries = 0;
+}
+
+/*
+  Seqlock_Write
+  ----------------------------------------------------------------------
+  Copy a new record in, from the one writer. The writer must not be
+  preempted by a reader of the same seqlock, so it has to run at a
+  higher priority than every reader, like an ISR writing for main.
+
+  Parameters:   1) seqlock
+                2) new record, size bytes
+  Return value: none
+*/
+void Seqlock_Write(seqlock* s, const void* rec) {
+    uint32_t seq = s->seq;
+    s->seq = seq + 1;                   //odd, readers will start over
+    __DMB();
+    memcpy(s->data,rec,s->size);
+    __DMB();
+    s->seq = seq + 2;
+}
+
+/*
+  Seqlock_Read
+  ----------------------------------------------------------------------
+  Copy the newest whole record out. If the writer runs in the middle,
+  the copy is thrown away and made again.
+
+  Parameters:   1) seqlock
+                2) where to copy the record, size bytes
+  Return value: sequence count of the copy, goes up by 2 a write
+*/
+uint32_t Seqlock_Read(seqlock* s, void* rec) {
+    uint32_t seq;
+    while(1)
+    {
+        seq = s->seq;
+        __DMB();
+        memcpy(rec,s->data,s->size);
+        __DMB();
+        if(!(seq & 1) && seq == s->seq) return seq;
+        s->retries++;
+    }
+}
@@ -0,0 +1,69 @@
+// RCR_Seqlock.h
+// Compatible with MSP432
+// Abhi Kallur
+
+// Shares the newest copy of a small record from one
+// writer, like an ISR, with readers in lower priority
+// code. The writer makes the sequence count odd,
+// copies the record in and makes it even again. A
+// reader copies the record out between two reads of
+// the count and tries again if it changed or was odd,
+// so it always ends up with one whole record. Nobody
+// masks interrupts and the writer never waits.
+
+#ifndef RCR_SEQLOCK_H_
+#define RCR_SEQLOCK_H_
+
+
+// a record behind a sequence count, set up by Seqlock_Init
+struct Seqlock
+{
+    void*    data;              // the record, size bytes
+    uint16_t size;              // bytes in the record
+    volatile uint32_t seq;      // odd while the writer is copying
+    volatile uint32_t retries;  // reads that had to start over
+};
+
+typedef struct Seqlock seqlock;
+
+
+/*
+  Seqlock_Init
+  ----------------------------------------------------------------------
+  Put a record behind a sequence count. The record's contents are the
+  first copy readers get.
+
+  Parameters:   1) seqlock to set up
+                2) record, must stay valid
+                3) bytes in the record
+  Return value: none
+*/
+void Seqlock_Init(seqlock* s, void* data, uint16_t size);
+
+/*
+  Seqlock_Write
+  ----------------------------------------------------------------------
+  Copy a new record in, from the one writer. The writer must not be
+  preempted by a reader of the same seqlock, so it has to run at a
+  higher priority than every reader, like an ISR writing for main.
+
+  Parameters:   1) seqlock
+                2) new record, size bytes
+  Return value: none
+*/
+void Seqlock_Write(seqlock* s, const void* rec);
+
+/*
+  Seqlock_Read
+  ----------------------------------------------------------------------
+  Copy the newest whole record out. If the writer runs in the middle,
+  the copy is thrown away and made again.
+
+  Parameters:   1) seqlock
+                2) where to copy the record, size bytes
+  Return value: sequence count of the copy, goes up by 2 a write
+*/
+uint32_t Seqlock_Read(seqlock* s, void* rec);
+
+
+#endif /* RCR_SEQLOCK_H_ */
@@ -0,0 +1,158 @@
+// RCR_SysID.c
+// Compatible with MSP432
+// Abhi Kallur
+
+// Measures the motors instead of guessing them.
+// Drives both wheels through a list of open loop
+// duty steps and logs the tachometer speeds into
+// RAM from the Timer A2 interrupt. The log is read
+// out with the debugger, or printed by
+// ./robot_sim sysid, and tools/fit_motor.c fits
+// the gain, time constant and deadband of each
+// wheel into RCR_MotorID.h.
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "msp.h"
+#include "CortexM.h"
+#include "RCR_TimerA2.h"
+#include "RCR_Tach.h"
+#include "RCR_Motor.h"
+#include "RCR_SysID.h"
+
+static sysid_sample SysID_Buffer[SYSID_SAMPLES];    //save from here to a file with the debugger
+static uint16_t SysID_Count;            //samples in SysID_Buffer
+static const sysid_step* SysID_Steps;   //steps of the run
+static uint8_t  SysID_Step_Count;
+static uint8_t  SysID_Index;            //running step
+static uint32_t SysID_Left;             //samples left in the running step
+static volatile uint8_t SysID_Running;
+static void (*SysIDDone)(void);         // user task called when the run ends
+
+
+// start the step at SysID_Index
+static void SysID_Apply(void) {
+    const sysid_step* step = &SysID_Steps[SysID_Index];
+    SysID_Left = ((uint32_t)step->ms*SYSID_HZ + 999)/1000;
+    Motor_SetVelocity(step->duty,step->duty);
+}
+
+// end the run, called with interrupts masked
+static void SysID_End(void) {
+    TimerA2_Stop();
+    SysID_Running = 0;
+    if(SysIDDone) (*SysIDDone)();
+}
+
+// Timer A2 task, logs a sample and moves on to the next step, masked
+// so SysID_Abort from a crash can't land between the check and a step
+static void SysID_Sample(void) {
+    int32_t left, right;
+    long sr = StartCritical();
+    if(!SysID_Running)
+    {
+        EndCritical(sr);
+        return;
+    }
+    Tach_Read(&left,&right);
+    SysID_Buffer[SysID_Count].duty  = SysID_Steps[SysID_Index].duty;
+    SysID_Buffer[SysID_Count].left  = left;
+    SysID_Buffer[SysID_Count].right = right;
+    SysID_Count++;
+
+    if(SysID_Left) SysID_Left--;
+    if(SysID_Left && SysID_Count < SYSID_SAMPLES)
+    {
+        EndCritical(sr);
+        return;
+    }
+    SysID_Index++;
+    if(SysID_Index < SysID_Step_Count && SysID_Count < SYSID_SAMPLES)
+    {
+        SysID_Apply();
+        EndCritical(sr);
+        return;
+    }
+    Motor_Stop();
+    SysID_End();
+    EndCritical(sr);
+}
+
+
+/*
+  SysID_Start
+  ----------------------------------------------------------------------
+  Run the steps in order, logging both wheel speeds SYSID_HZ times a
+  second from the first step until the last one ends or the log is
+  full, then stop the motors and call the done task. Each step is a
+  Motor_SetVelocity on both wheels, so turn the ramp off first with
+  Motor_SetRamp(0,0) or the fit sees the ramp instead of the motor.
+  Timer A2 is taken over for the run, so it can't be used with the
+  motion queue. A crash has to call SysID_Abort, or the next step
+  drives into the obstacle again. Assumes Motor_Init() and Tach_Init()
+  have been called.
+
+  Parameters:   1) steps to run, must stay valid until the done task
+                2) number of steps
+                3) function pointer to user task called from the
+                       interrupt when the run ends, can be null
+  Return value: none
+*/
+void SysID_Start(const sysid_step* steps, uint8_t count, void(*done)(void)) {
+    TimerA2_Stop();
+    SysIDDone        = done;
+    SysID_Steps      = steps;
+    SysID_Step_Count = count;
+    SysID_Index      = 0;
+    SysID_Count      = 0;
+    if(!count) return;
+    SysID_Running    = 1;
+    SysID_Apply();
+    TimerA2_Init(&SysID_Sample,SYSID_TICK);
+}
+
+/*
+  SysID_Busy
+  ----------------------------------------------------------------------
+  Gives whether a run is still going.
+
+  Parameters:   none
+  Return value: true until the last step ends
+*/
+bool SysID_Busy(void) {
+    return SysID_Running;
+}
+
+/*
+  SysID_Abort
+  ----------------------------------------------------------------------
+  End a run early, for a crash. No further step is applied, Timer A2
+  is stopped and the done task is called, the same as a run that ends.
+  The motors are left to whatever the caller did to them, like
+  Motor_Brake. The log keeps the samples taken up to here, so a run
+  cut short still fits, just with fewer steps.
+
+  Parameters:   none
+  Return value: true if a run was going, false if there was none
+*/
+bool SysID_Abort(void) {
+    long sr = StartCritical();
+    bool running = SysID_Running;
+    if(running) SysID_End();
+    EndCritical(sr);
+    return running;
+}
+
+/*
+  SysID_Log
+  ----------------------------------------------------------------------
+  Gives the samples logged by the last run, SYSID_HZ apart.
+
+  Parameters:   1) pointer to store the address of the first sample
+  Return value: number of samples
+*/
+uint16_t SysID_Log(const sysid_sample** log) {
+    *log = SysID_Buffer;
+    return SysID_Count;
+}
@@ -0,0 +1,104 @@
+// RCR_SysID.h
+// Compatible with MSP432
+// Abhi Kallur
+
+// Measures the motors instead of guessing them.
+// Drives both wheels through a list of open loop
+// duty steps and logs the tachometer speeds into
+// RAM from the Timer A2 interrupt. The log is read
+// out with the debugger, or printed by
+// ./robot_sim sysid, and tools/fit_motor.c fits
+// the gain, time constant and deadband of each
+// wheel into RCR_MotorID.h.
+
+#ifndef RCR_SYSID_H_
+#define RCR_SYSID_H_
+
+#include <stdbool.h>
+
+#define SYSID_HZ       500      //samples per second, 50 per 100 ms time constant
+#define SYSID_TICK     3000     //Timer A2 cycles between samples
+#ifdef RCR_SYSID
+#define SYSID_SAMPLES  2500     //5 s of log, 15 kB of RAM
+#else
+#define SYSID_SAMPLES  1        //race builds don't carry the log, build with RCR_SYSID defined to measure
+#endif
+
+
+// one duty step, held on both wheels for its time
+struct SysID_Step
+{
+    int16_t  duty;              // Q15 fraction of full power, negative is backward
+    uint16_t ms;                // time to hold it
+};
+
+typedef struct SysID_Step sysid_step;
+
+// one line of the log
+struct SysID_Sample
+{
+    int16_t  duty;              // duty being applied, before the battery scale
+    int16_t  left;              // left wheel speed in mm/s, see Tach_Read
+    int16_t  right;             // right wheel speed in mm/s
+};
+
+typedef struct SysID_Sample sysid_sample;
+
+
+/*
+  SysID_Start
+  ----------------------------------------------------------------------
+  Run the steps in order, logging both wheel speeds SYSID_HZ times a
+  second from the first step until the last one ends or the log is
+  full, then stop the motors and call the done task. Each step is a
+  Motor_SetVelocity on both wheels, so turn the ramp off first with
+  Motor_SetRamp(0,0) or the fit sees the ramp instead of the motor.
+  Timer A2 is taken over for the run, so it can't be used with the
+  motion queue. A crash has to call SysID_Abort, or the next step
+  drives into the obstacle again. Assumes Motor_Init() and Tach_Init()
+  have been called.
+
+  Parameters:   1) steps to run, must stay valid until the done task
+                2) number of steps
+                3) function pointer to user task called from the
+                       interrupt when the run ends, can be null
+  Return value: none
+*/
+void SysID_Start(const sysid_step* steps, uint8_t count, void(*done)(void));
+
+/*
+  SysID_Busy
+  ----------------------------------------------------------------------
+  Gives whether a run is still going.
+
+  Parameters:   none
+  Return value: true until the last step ends
+*/
+bool SysID_Busy(void);
+
+/*
+  SysID_Abort
+  ----------------------------------------------------------------------
+  End a run early, for a crash. No further step is applied, Timer A2
+  is stopped and the done task is called, the same as a run that ends.
+  The motors are left to whatever the caller did to them, like
+  Motor_Brake. The log keeps the samples taken up to here, so a run
+  cut short still fits, just with fewer steps.
+
+  Parameters:   none
+  Return value: true if a run was going, false if there was none
+*/
+bool SysID_Abort(void);
+
+/*
+  SysID_Log
+  ----------------------------------------------------------------------
+  Gives the samples logged by the last run, SYSID_HZ apart.
+
+  Parameters:   1) pointer to store the address of the first sample
+  Return value: number of samples
+*/
+uint16_t SysID_Log(const sysid_sample** log);
+
+
+#endif /* RCR_SYSID_H_ */
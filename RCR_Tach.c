@@ -0,0 +1,179 @@
+// RCR_Tach.c
+// Compatible with MSP432
+// Abhi Kallur
+
+// Provides a tachometer for both wheels from
+// the RSLK encoders. Timer A3 captures every
+// rising edge of encoder A, the time between
+// edges gives the speed and encoder B gives
+// the direction.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "msp.h"
+#include "CortexM.h"
+#include "RCR_Tach.h"
+
+
+/*
+ Hardware connections
+ ---------------------------------------------------------
+ P10.5 (TimerA3 sub 1) connected to Left encoder A
+ P5.2 connected to Left encoder B
+ P10.4 (TimerA3 sub 0) connected to Right encoder A
+ P5.0 connected to Right encoder B
+*/
+
+// mm per encoder edge times counts per second, over the period in counts gives mm/s
+#define TACH_K   ((uint32_t)(3.14159265*WHEEL_DIAM*TACH_HZ/ENC_EDGES))
+
+struct Tach_Wheel {
+    uint16_t last;          //capture of the last edge
+    uint16_t period;        //counts between the last 2 edges, 0 until there are 2
+    uint8_t  overflows;     //timer overflows since the last edge, stops at 2
+    int8_t   dir;           //1 is forward, -1 is backward
+    int32_t  count;         //edges since Tach_Init, signed by dir
+};
+typedef struct Tach_Wheel tach_wheel;
+
+static volatile tach_wheel Tach_Left, Tach_Right;
+
+
+/*
+  Tach_Init
+  ----------------------------------------------------------------------
+  Initialize Timer A3 to capture the rising edges of both encoder A
+  signals. The SMCLK(12 MHz) is divided by 32 to run the timer at
+  375 kHz in continuous mode, so one count is 2.7 us and the slowest
+  speed measured is about 2 mm/s. Each capture interrupts with a
+  priority of 2 to save the period and direction, and the overflow
+  interrupt times out a stopped wheel.
+
+  Parameters:   none
+  Return value: none
+*/
+void Tach_Init(void) {
+    P10->SEL0 |=  0x30;          //configure pins for TA3 capture inputs
+    P10->SEL1 &= ~0x30;
+    P10->DIR  &= ~0x30;
+
+    P5->SEL0  &= ~0x05;          //encoder B pins are inputs
+    P5->SEL1  &= ~0x05;
+    P5->DIR   &= ~0x05;
+
+    Tach_Left.period  = Tach_Right.period  = 0;
+    Tach_Left.overflows = Tach_Right.overflows = 2;
+    Tach_Left.dir     = Tach_Right.dir     = 1;
+    Tach_Left.count   = Tach_Right.count   = 0;
+
+    TA3CTL  &= ~0x0030;
+    TA3CTL   =  0x02C0;          //ctl: halt timer, SMCLK, divide by 8
+    TA3EX0   =  0x0003;          //ex: another divide by 4
+
+    TA3CCTL0 =  0x4910;          //cctl's: capture rising edge, CCIxA, sync, arm interrupt
+    TA3CCTL1 =  0x4910;
+
+    NVIC->IP[14]   = 0x40;          //priority 2
+    NVIC->IP[15]   = 0x40;
+    NVIC->ISER[0] |= 0x0000C000;    //enable TA3_0(irq 14) and TA3_N(irq 15) interrupts
+
+    TA3CTL  |=  0x0026;          //ctl: continuous mode, set clear bit, arm overflow interrupt
+}
+
+
+// speed of one wheel, called with interrupts masked
+static int32_t Tach_Speed(volatile tach_wheel* w, uint16_t now) {
+    uint32_t elapsed = (uint16_t)(now - w->last);
+    if(w->overflows >= 2 || w->period == 0) return 0;
+    if(w->overflows == 1 && now >= w->last) return 0;  //a full wrap or more
+    if(elapsed < w->period) elapsed = w->period;
+    return w->dir*(int32_t)(TACH_K/elapsed);
+}
+
+/*
+  Tach_Read
+  ----------------------------------------------------------------------
+  Gives the speed of both wheels from the last period between encoder
+  edges. If the wheel has gone longer than that without an edge the
+  time since the last edge is used instead, so a slowing wheel reads
+  slower right away. A wheel with no edge for a full wrap of the timer
+  (175 ms) reads 0.
+
+  Parameters:   1) pointer to store the left wheel speed in mm/s,
+                       positive is forward
+                2) pointer to store the right wheel speed in mm/s
+  Return value: none
+*/
+void Tach_Read(int32_t* left, int32_t* right) {
+    long sr = StartCritical();
+    uint16_t now = TA3R;
+    *left  = Tach_Speed(&Tach_Left,now);
+    *right = Tach_Speed(&Tach_Right,now);
+    EndCritical(sr);
+}
+
+/*
+  Tach_Count
+  ----------------------------------------------------------------------
+  Gives the distance each wheel has turned since Tach_Init, counted in
+  rising edges of encoder A, up going forward and down going backward.
+  One edge is pi*WHEEL_DIAM/ENC_EDGES, about 0.61 mm.
+
+  Parameters:   1) pointer to store the left wheel count
+                2) pointer to store the right wheel count
+  Return value: none
+*/
+void Tach_Count(int32_t* left, int32_t* right) {
+    long sr = StartCritical();
+    *left  = Tach_Left.count;
+    *right = Tach_Right.count;
+    EndCritical(sr);
+}
+
+
+// new edge on one wheel
+static void Tach_Edge(volatile tach_wheel* w, uint16_t capture, uint8_t forward) {
+    bool wrapped = (w->overflows >= 2) || (w->overflows == 1 && capture >= w->last);
+    w->period    = wrapped ? 0 : (uint16_t)(capture - w->last);
+    w->last      = capture;
+    w->overflows = 0;
+    w->dir       = forward ? 1 : -1;
+    w->count    += w->dir;
+}
+
+/*
+  TA3_0_IRQHandler
+  ----------------------------------------------------------------------
+  Timer A3 capture interrupt on a rising edge of the right encoder A.
+  Encoder B is high here when the wheel turns forward.
+
+  Parameters:   none
+  Return value: none
+*/
+void TA3_0_IRQHandler(void) {
+    TA3CCTL0 &= ~0x0001;         //clear interrupt flag
+    Tach_Edge(&Tach_Right,TA3CCR0,P5->IN & 0x01);
+}
+
+/*
+  TA3_N_IRQHandler
+  ----------------------------------------------------------------------
+  Timer A3 interrupt on a rising edge of the left encoder A, or on the
+  timer overflowing.
+
+  Parameters:   none
+  Return value: none
+*/
+void TA3_N_IRQHandler(void) {
+    if(TA3CCTL1 & 0x0001)
+    {
+        TA3CCTL1 &= ~0x0001;     //clear interrupt flag
+        Tach_Edge(&Tach_Left,TA3CCR1,P5->IN & 0x04);
+    }
+    if(TA3CTL & 0x0001)
+    {
+        TA3CTL &= ~0x0001;       //clear overflow flag
+        if(Tach_Left.overflows < 2)  Tach_Left.overflows++;
+        if(Tach_Right.overflows < 2) Tach_Right.overflows++;
+    }
+}
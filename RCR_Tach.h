@@ -0,0 +1,74 @@
+// RCR_Tach.h
+// Compatible with MSP432
+// Abhi Kallur
+
+// Provides a tachometer for both wheels from
+// the RSLK encoders. Timer A3 captures every
+// rising edge of encoder A, the time between
+// edges gives the speed and encoder B gives
+// the direction.
+
+#ifndef RCR_TACH_H_
+#define RCR_TACH_H_
+
+
+/*
+ Hardware connections
+ ---------------------------------------------------------
+ P10.5 (TimerA3 sub 1) connected to Left encoder A
+ P5.2 connected to Left encoder B
+ P10.4 (TimerA3 sub 0) connected to Right encoder A
+ P5.0 connected to Right encoder B
+*/
+
+#define WHEEL_DIAM    70        //in mm
+#define ENC_EDGES     360       //rising edges of encoder A per wheel turn
+#define TACH_HZ       375000    //Timer A3 clock, SMCLK(12 MHz)/32
+
+
+/*
+  Tach_Init
+  ----------------------------------------------------------------------
+  Initialize Timer A3 to capture the rising edges of both encoder A
+  signals. The SMCLK(12 MHz) is divided by 32 to run the timer at
+  375 kHz in continuous mode, so one count is 2.7 us and the slowest
+  speed measured is about 2 mm/s. Each capture interrupts with a
+  priority of 2 to save the period and direction, and the overflow
+  interrupt times out a stopped wheel.
+
+  Parameters:   none
+  Return value: none
+*/
+void Tach_Init(void);
+
+/*
+  Tach_Read
+  ----------------------------------------------------------------------
+  Gives the speed of both wheels from the last period between encoder
+  edges. If the wheel has gone longer than that without an edge the
+  time since the last edge is used instead, so a slowing wheel reads
+  slower right away. A wheel with no edge for a full wrap of the timer
+  (175 ms) reads 0.
+
+  Parameters:   1) pointer to store the left wheel speed in mm/s,
+                       positive is forward
+                2) pointer to store the right wheel speed in mm/s
+  Return value: none
+*/
+void Tach_Read(int32_t* left, int32_t* right);
+
+/*
+  Tach_Count
+  ----------------------------------------------------------------------
+  Gives the distance each wheel has turned since Tach_Init, counted in
+  rising edges of encoder A, up going forward and down going backward.
+  One edge is pi*WHEEL_DIAM/ENC_EDGES, about 0.61 mm.
+
+  Parameters:   1) pointer to store the left wheel count
+                2) pointer to store the right wheel count
+  Return value: none
+*/
+void Tach_Count(int32_t* left, int32_t* right);
+
+
+#endif /* RCR_TACH_H_ */
@@ -4,9 +4,10 @@
 
 // Initializes Timer 0A module for use with
 // motors. Timer 0A pins are used for PWM to
-// control the speed of the motors. No
-// interrupts needed, as the pins are set up
-// to be controlled by the hardware.
+// control the speed of the motors. The pins
+// are controlled by the hardware, the CCR0
+// interrupt is only used to sync changes to
+// the start of a PWM period.
 
 /* This example accompanies the book
    "Embedded Systems: Introduction to Robotics,
@@ -44,6 +45,7 @@ policies, either expressed or implied, of the FreeBSD Project.
 
 #include <stdint.h>
 #include "msp.h"
+#include "CortexM.h"
 #include "RCR_TimerA0.h"
 
 
@@ -55,7 +57,28 @@ policies, either expressed or implied, of the FreeBSD Project.
 */
 
 
-//void (*TimerA0Task)(void);   // user function
+static void (*TimerA0Task)(void);   // user task called once at the next period rollover
+
+#define SMCLK_HZ        12000000        // Timer A0 clock before the dividers
+
+static uint16_t PWM_Scale;              // clk cycles in 100% duty, a Q15 duty times this >> 15 is TA0CCR3/4
+
+#define SHADOW_RIGHT    0x01            // Shadow_Pending bits
+#define SHADOW_LEFT     0x02
+
+static bool     Shadow_On;              // SetDuty_Right/Left stage instead of writing
+static uint8_t  Shadow_Pending;         // staged channels waiting for the rollover
+static uint16_t Shadow_Right;           // staged TA0CCR3
+static uint16_t Shadow_Left;            // staged TA0CCR4
+static uint32_t Shadow_Dropped;         // staged duties overwritten before the rollover
+
+
+// arm the CCR0 interrupt for the next rollover, called with interrupts masked
+static void TimerA0_Arm(void) {
+    if(TA0CCTL0 & 0x0010) return;           //already armed
+    TA0CCTL0 &= ~0x0001;                    //clear interrupt flag from an earlier rollover
+    TA0CCTL0 |=  0x0010;                    //arm interrupt
+}
 
 
 
@@ -64,26 +87,36 @@ policies, either expressed or implied, of the FreeBSD Project.
   ----------------------------------------------------------------------
   This will initialize Timer A0 to run hardware task periodically. This
   timer functions as a PWM output to both motors, done through output
-  pins. The SMCLK(12 MHz) is used and scaled by 8 to run the timer at
-  1.5 MHz. The period and duty cycles are selected based on the device's
-  time constant and desired speed/intensity. It uses compare mode to set/reset the
-  pins if the counter matches the selected duty cycle. The counter is set
-  to count in the up direction. No interrupts needed as PWM output is
-  handled in hardware.
-
-  The brushed DC motors being used have a time constant of 100 ms. Our period
-  is set to 10 ms(15000 clk cycles) for now.
-
-  Parameters:   1) time(in clk cycles) to calculate duty cycles from,
-                       must fit within 16 bits
-                2) speed(in clk cycles) of left motor as percentage of period(dutyLeft/period),
-                       must be < period-1
-                3) speed(in clk cycles) of right motor as percentage of period(dutyRight/period),
-                       must be < period-1
+  pins. The SMCLK(12 MHz) is divided by the smallest amount that fits
+  the period in 16 bits, so each frequency gets the finest duty cycle
+  steps it can, like 600 steps at 20 kHz or 60000 at 100 Hz. It uses
+  compare mode to set/reset the pins if the counter matches the selected
+  duty cycle. The counter is set to count in the up direction. PWM output
+  is handled in hardware, the CCR0 interrupt is left disarmed until
+  TimerA0_Sync is called.
+
+  Duty cycles are given as a Q15 fraction of the period(32768 = 100%)
+  and converted to clk cycles here, so callers don't depend on the
+  frequency.
+
+  Parameters:   1) PWM frequency in Hz, 3 to 120000
+                2) speed of left motor as a Q15 fraction of the period,
+                       must be < 32768
+                3) speed of right motor as a Q15 fraction of the period,
+                       must be < 32768
   Return value: none
 */
-void TimerA0_Init(uint16_t period, uint16_t dutyLeft, uint16_t dutyRight) {
-    if(dutyLeft >= period-1 || dutyRight >= period-1)
+void TimerA0_Init(uint32_t freq, uint16_t dutyLeft, uint16_t dutyRight) {
+    uint32_t div, id = 0, ex, period;
+    if(freq < 3) freq = 3;
+    if(freq > 120000) freq = 120000;
+    div = (SMCLK_HZ/freq + 65535)/65536;    //smallest divide that fits the period in 16 bits
+    while((1u << id) < div && id < 3) id++; //ID divides by 1, 2, 4 or 8
+    ex = (div + (1u << id) - 1) >> id;      //EX0 divides the rest, 1 to 8
+    period = SMCLK_HZ/((1u << id)*ex)/freq;
+    if(period > 65536) period = 65536;
+    PWM_Scale = period - 2;                 //100% duty stays under CCR0-1
+    if(dutyLeft > 32767 || dutyRight > 32767)
     {
         dutyLeft = dutyRight = 0;
     }
@@ -93,15 +126,23 @@ void TimerA0_Init(uint16_t period, uint16_t dutyLeft, uint16_t dutyRight) {
     P2->DIR   |=  0xC0;
 
     TA0CTL &= ~0x0030;
-    TA0CTL =   0x02C0;           //ctl: halt timer, SMCLK, divide by 8
-    TA0EX0 =   0x0000;           //ex: set for divide by 1
+    TA0CTL =   0x0200 | (id << 6);  //ctl: halt timer, SMCLK, divide by 2^id
+    TA0EX0 =   ex - 1;              //ex: another divide by ex
 
     TA0CCTL0 = 0x0080;           //cctl's: compare mode, outmode = reset/set
     TA0CCTL3 = 0x00E0;
     TA0CCTL4 = 0x00E0;
-    TA0CCR0  = period;           //ccr's: load in clk cycles
-    TA0CCR3  = dutyRight;
-    TA0CCR4  = dutyLeft;
+    TA0CCR0  = period - 1;       //ccr's: up mode counts 0 to CCR0
+    TA0CCR3  = ((uint32_t)dutyRight*PWM_Scale) >> 15;
+    TA0CCR4  = ((uint32_t)dutyLeft*PWM_Scale) >> 15;
+
+    Shadow_On      = false;
+    Shadow_Pending = 0;
+    Shadow_Dropped = 0;
+    TimerA0Task    = 0;
+
+    NVIC->IP[8]    = 0x00;          //priority 0, PWM changes have to land at the rollover
+    NVIC->ISER[0] |= 0x00000100;    //enable TA0_0(irq 8) interrupt, armed by TimerA0_Sync
 
     TA0CTL  |=  0x0014;          //ctl: set for up mode, set clear bit
 }
@@ -110,15 +151,29 @@ void TimerA0_Init(uint16_t period, uint16_t dutyLeft, uint16_t dutyRight) {
 /*
   SetDuty_Right
   ----------------------------------------------------------------------
-  Changes the speed of the motor to selected duty cycle.
+  Changes the speed of the motor to selected duty cycle. In shadow mode
+  the change is staged until the end of the PWM period.
 
-  Parameters:   1) speed(in clk cycles) of right motor as percentage of period(num_cycles/TA0CCR0),
-                       must be < TA0CCR0-1
+  Parameters:   1) speed of right motor as a Q15 fraction of the period,
+                       must be < 32768
   Return value: true if valid parameter, false if invalid parameter
 */
-bool SetDuty_Right(uint16_t num_cycles) {
-    if(num_cycles >= TA0CCR0-1) return false;
-    TA0CCR3 = num_cycles;
+bool SetDuty_Right(uint16_t duty) {
+    long sr;
+    uint16_t num_cycles;
+    if(duty > 32767) return false;
+    num_cycles = ((uint32_t)duty*PWM_Scale) >> 15;
+    if(!Shadow_On)
+    {
+        TA0CCR3 = num_cycles;
+        return true;
+    }
+    sr = StartCritical();
+    if(Shadow_Pending & SHADOW_RIGHT) Shadow_Dropped++;
+    Shadow_Right    = num_cycles;
+    Shadow_Pending |= SHADOW_RIGHT;
+    TimerA0_Arm();
+    EndCritical(sr);
     return true;
 }
 
@@ -126,21 +181,114 @@ bool SetDuty_Right(uint16_t num_cycles) {
 /*
   SetDuty_Left
   ----------------------------------------------------------------------
-  Changes the speed of the motor to selected duty cycle.
+  Changes the speed of the motor to selected duty cycle. In shadow mode
+  the change is staged until the end of the PWM period.
 
-  Parameters:   1) speed(in clk cycles) of left motor as percentage of period(num_cycles/TA0CCR0),
-                       must be < TA0CCR0-1
+  Parameters:   1) speed of left motor as a Q15 fraction of the period,
+                       must be < 32768
   Return value: true if valid parameter, false if invalid parameter
 */
-bool SetDuty_Left(uint16_t num_cycles) {
-    if(num_cycles >= TA0CCR0-1) return false;
-    TA0CCR4 = num_cycles;
+bool SetDuty_Left(uint16_t duty) {
+    long sr;
+    uint16_t num_cycles;
+    if(duty > 32767) return false;
+    num_cycles = ((uint32_t)duty*PWM_Scale) >> 15;
+    if(!Shadow_On)
+    {
+        TA0CCR4 = num_cycles;
+        return true;
+    }
+    sr = StartCritical();
+    if(Shadow_Pending & SHADOW_LEFT) Shadow_Dropped++;
+    Shadow_Left     = num_cycles;
+    Shadow_Pending |= SHADOW_LEFT;
+    TimerA0_Arm();
+    EndCritical(sr);
     return true;
 }
 
-//void TA0_0_IRQHandler(void) {
-//  TA0CCTL0 &= ~0x0001;        // clear interrupt flag
-//  (*TimerA0Task)();
-//}
+/*
+  TimerA0_Sync
+  ----------------------------------------------------------------------
+  Arm the Timer A0 CCR0 interrupt to call a user task once, at the end
+  of the current PWM period, after any staged duty cycles are written.
+  Anything the task changes takes effect together at the start of the
+  next period, while both PWM outputs are being set. Arming again before
+  the period ends replaces the task.
+  The interrupt has a priority of 0 so the task runs right at the
+  rollover. Assumes TimerA0_Init() has been called.
+
+  Parameters:   1) function pointer to user task to be called once at
+                   the next period rollover
+  Return value: none
+*/
+void TimerA0_Sync(void(*task)(void)) {
+    long sr = StartCritical();
+    TimerA0Task = task;
+    TimerA0_Arm();
+    EndCritical(sr);
+}
+
+// write the staged duty cycles, called with the CCR0 interrupt masked
+static void Shadow_Commit(void) {
+    if(Shadow_Pending & SHADOW_RIGHT) TA0CCR3 = Shadow_Right;
+    if(Shadow_Pending & SHADOW_LEFT)  TA0CCR4 = Shadow_Left;
+    Shadow_Pending = 0;
+}
+
+/*
+  TimerA0_Shadow
+  ----------------------------------------------------------------------
+  Turn shadow register mode on or off. In shadow mode SetDuty_Right and
+  SetDuty_Left only stage the new duty cycle in RAM and arm the CCR0
+  interrupt, which writes every staged duty cycle at the end of the PWM
+  period. Both wheels then change speed at the same rollover. Turning
+  the mode off writes anything still staged right away. Assumes
+  TimerA0_Init() has been called.
+
+  Parameters:   1) true for shadow mode, false to write duty cycles
+                   right away
+  Return value: none
+*/
+void TimerA0_Shadow(bool on) {
+    long sr = StartCritical();
+    if(!on) Shadow_Commit();
+    Shadow_On = on;
+    EndCritical(sr);
+}
+
+/*
+  TimerA0_Dropped
+  ----------------------------------------------------------------------
+  Number of staged duty cycles that were overwritten by another call
+  before the end of the PWM period, so they never reached the timer.
+  For profiling how often the caller retunes faster than the PWM.
+
+  Parameters:   none
+  Return value: count since TimerA0_Init
+*/
+uint32_t TimerA0_Dropped(void) {
+    return Shadow_Dropped;
+}
+
+/*
+  TA0_0_IRQHandler
+  ----------------------------------------------------------------------
+  Timer A0 CCR0 interrupt that occurs at the end of the PWM period after
+  a duty cycle was staged or TimerA0_Sync was called. Writes both staged
+  duty cycles together, then calls the TimerA0_Sync task once. It stays
+  disarmed until the next one, so it is only taken when something
+  changes.
+
+  Parameters:   none
+  Return value: none
+*/
+void TA0_0_IRQHandler(void) {
+    void (*task)(void) = TimerA0Task;
+    TA0CCTL0 &= ~0x0011;    //clear interrupt flag, disarm interrupt
+    Shadow_Commit();
+    TimerA0Task = 0;
+    if(task) (*task)();
+}
 
 
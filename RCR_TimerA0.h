@@ -4,9 +4,10 @@
 
 // Initializes Timer 0A module for use with
 // motors. Timer 0A pins are used for PWM to
-// control the speed of the motors. No
-// interrupts needed, as the pins are set up
-// to be controlled by the hardware.
+// control the speed of the motors. The pins
+// are controlled by the hardware, the CCR0
+// interrupt is only used to sync changes to
+// the start of a PWM period.
 
 /* This example accompanies the book
    "Embedded Systems: Introduction to Robotics,
@@ -61,47 +62,95 @@ policies, either expressed or implied, of the FreeBSD Project.
   ----------------------------------------------------------------------
   This will initialize Timer A0 to run hardware task periodically. This
   timer functions as a PWM output to both motors, done through output
-  pins. The SMCLK(12 MHz) is used and divided by 8 to run the timer at
-  1.5 MHz. The period and duty cycles are selected based on the device's
-  time constant and desired speed/intensity. It uses compare mode to set/reset the
-  pins if the counter matches the selected duty cycle. The counter is set
-  to count in the up direction. No interrupts needed as PWM output is
-  handled in hardware.
-
-  The brushed DC motors being used have a time constant of 100 ms. Our period
-  is set to 10 ms(15000 clk cycles) for now.
-
-  Parameters:   1) time(in clk cycles) to calculate duty cycles from,
-                       must fit within 16 bits
-                2) speed(in clk cycles) of left motor as percentage of period(dutyLeft/period),
-                       must be < period-1
-                3) speed(in clk cycles) of right motor as percentage of period(dutyRight/period),
-                       must be < period-1
+  pins. The SMCLK(12 MHz) is divided by the smallest amount that fits
+  the period in 16 bits, so each frequency gets the finest duty cycle
+  steps it can, like 600 steps at 20 kHz or 60000 at 100 Hz. It uses
+  compare mode to set/reset the pins if the counter matches the selected
+  duty cycle. The counter is set to count in the up direction. PWM output
+  is handled in hardware, the CCR0 interrupt is left disarmed until
+  TimerA0_Sync is called.
+
+  Duty cycles are given as a Q15 fraction of the period(32768 = 100%)
+  and converted to clk cycles here, so callers don't depend on the
+  frequency.
+
+  Parameters:   1) PWM frequency in Hz, 3 to 120000
+                2) speed of left motor as a Q15 fraction of the period,
+                       must be < 32768
+                3) speed of right motor as a Q15 fraction of the period,
+                       must be < 32768
   Return value: none
 */
-void TimerA0_Init(uint16_t period, uint16_t dutyLeft, uint16_t dutyRight);
+void TimerA0_Init(uint32_t freq, uint16_t dutyLeft, uint16_t dutyRight);
 
 /*
   SetDuty_Right
   ----------------------------------------------------------------------
-  Changes the speed of the motor to selected duty cycle.
+  Changes the speed of the motor to selected duty cycle. In shadow mode
+  the change is staged until the end of the PWM period.
 
-  Parameters:   1) speed(in clk cycles) of right motor as percentage of period(num_cycles/TA0CCR0),
-                       must be < TA0CCR0-1
+  Parameters:   1) speed of right motor as a Q15 fraction of the period,
+                       must be < 32768
   Return value: true if valid parameter, false if invalid parameter
 */
-bool SetDuty_Right(uint16_t num_cycles);
+bool SetDuty_Right(uint16_t duty);
 
 /*
   SetDuty_Left
   ----------------------------------------------------------------------
-  Changes the speed of the motor to selected duty cycle.
+  Changes the speed of the motor to selected duty cycle. In shadow mode
+  the change is staged until the end of the PWM period.
 
-  Parameters:   1) speed(in clk cycles) of left motor as percentage of period(num_cycles/TA0CCR0),
-                       must be < TA0CCR0-1
+  Parameters:   1) speed of left motor as a Q15 fraction of the period,
+                       must be < 32768
   Return value: true if valid parameter, false if invalid parameter
 */
-bool SetDuty_Left(uint16_t num_cycles);
+bool SetDuty_Left(uint16_t duty);
+
+/*
+  TimerA0_Sync
+  ----------------------------------------------------------------------
+  Arm the Timer A0 CCR0 interrupt to call a user task once, at the end
+  of the current PWM period, after any staged duty cycles are written.
+  Anything the task changes takes effect together at the start of the
+  next period, while both PWM outputs are being set. Arming again before
+  the period ends replaces the task.
+  The interrupt has a priority of 0 so the task runs right at the
+  rollover. Assumes TimerA0_Init() has been called.
+
+  Parameters:   1) function pointer to user task to be called once at
+                   the next period rollover
+  Return value: none
+*/
+void TimerA0_Sync(void(*task)(void));
+
+/*
+  TimerA0_Shadow
+  ----------------------------------------------------------------------
+  Turn shadow register mode on or off. In shadow mode SetDuty_Right and
+  SetDuty_Left only stage the new duty cycle in RAM and arm the CCR0
+  interrupt, which writes every staged duty cycle at the end of the PWM
+  period. Both wheels then change speed at the same rollover. Turning
+  the mode off writes anything still staged right away. Assumes
+  TimerA0_Init() has been called.
+
+  Parameters:   1) true for shadow mode, false to write duty cycles
+                   right away
+  Return value: none
+*/
+void TimerA0_Shadow(bool on);
+
+/*
+  TimerA0_Dropped
+  ----------------------------------------------------------------------
+  Number of staged duty cycles that were overwritten by another call
+  before the end of the PWM period, so they never reached the timer.
+  For profiling how often the caller retunes faster than the PWM.
+
+  Parameters:   none
+  Return value: count since TimerA0_Init
+*/
+uint32_t TimerA0_Dropped(void);
 
 
 #endif // RCR_TIMERA0_H__
@@ -81,6 +81,37 @@ void TimerA1_Init(void(*task)(void), uint16_t period) {
     TA1CTL  |= 0x0014;     //reset counter and set for up mode
 }
 
+/*
+  TimerA1_InitTrigger
+  ----------------------------------------------------------------------
+  Initialize Timer A1 as a hardware trigger for the ADC14 instead of
+  running a user task. The SMCLK(12 MHz) is used without scaling so
+  high sample rates can be picked. Output TA1.1 is set to reset/set mode
+  and makes a rising edge at the start of each period, which starts the
+  next ADC14 conversion without the CPU. No interrupts or pins are used.
+
+  This replaces any user task from TimerA1_Init.
+
+  Parameters:   1) time(in clk cycles) between ADC14 triggers,
+                       must fit within 16 bits and be > 112 so a
+                       conversion finishes before the next trigger
+  Return value: none
+*/
+void TimerA1_InitTrigger(uint16_t period) {
+    TA1CTL  &= ~0x0030;     //halt timer
+    TA1CTL   = 0x0200;      //halt timer, smclk_12MHz, divide by 1
+    TA1EX0   = 0x0000;      //set for divide by 1
+
+    TA1CCTL0 = 0x0000;      //compare mode, no interrupt
+    TA1CCTL1 = 0x00E0;      //compare mode, outmode = reset/set, TA1.1 goes high at start of period
+    TA1CCR0  = period;      //load in cycles
+    TA1CCR1  = period/2;
+
+    NVIC->ICER[0]  = 0x00000400;    //disable TA1_0(irq 10) interrupt, no user task
+
+    TA1CTL  |= 0x0014;     //reset counter and set for up mode
+}
+
 /*
   TimerA1_Stop
   ----------------------------------------------------------------------
@@ -90,7 +121,7 @@ void TimerA1_Init(void(*task)(void), uint16_t period) {
   Return value: none
 */
 void TimerA1_Stop(void) {
-    NVIC->ICER[0] |= 0x00000400;    //disable TA1_0(irq 10) interrupt
+    NVIC->ICER[0]  = 0x00000400;    //disable TA1_0(irq 10) interrupt, writing 0 bits does nothing
 }
 
 /*
@@ -65,6 +65,24 @@ policies, either expressed or implied, of the FreeBSD Project.
 */
 void TimerA1_Init(void(*task)(void), uint16_t period);
 
+/*
+  TimerA1_InitTrigger
+  ----------------------------------------------------------------------
+  Initialize Timer A1 as a hardware trigger for the ADC14 instead of
+  running a user task. The SMCLK(12 MHz) is used without scaling so
+  high sample rates can be picked. Output TA1.1 is set to reset/set mode
+  and makes a rising edge at the start of each period, which starts the
+  next ADC14 conversion without the CPU. No interrupts or pins are used.
+
+  This replaces any user task from TimerA1_Init.
+
+  Parameters:   1) time(in clk cycles) between ADC14 triggers,
+                       must fit within 16 bits and be > 112 so a
+                       conversion finishes before the next trigger
+  Return value: none
+*/
+void TimerA1_InitTrigger(uint16_t period);
+
 /*
   TimerA1_Stop
   ----------------------------------------------------------------------
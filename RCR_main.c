@@ -16,104 +16,376 @@
 #include "RCR_TimerA1.h"
 #include "RCR_ADC14.h"
 #include "RCR_Motor.h"
+#include "RCR_Tach.h"
+#include "RCR_Battery.h"
+#include "RCR_Motion.h"
+#include "RCR_SysID.h"
 #include "RCR_Bumper.h"
 #include "RCR_SysTick.h"
+#include "RCR_Sched.h"
+#include "RCR_PendSV.h"
+#include "RCR_Ring.h"
+#include "RCR_Seqlock.h"
 
 #define DATA_X    45
 #define STOP_DIST 120   //in mm
+#define ESTOP_DIST 80   //in mm, raw samples closer than this stop the motors right away
 #define DISP_RATE 60    //multiply this by sample rate(10 ms for now) to get milliseconds
+#define TELEM_RATE 100  //scheduler report on the LCD every second
+#define TICK_CYCLES (SAMPLE_MS*48000)   //bus cycles in a scheduler tick
+#define ADC_CHNLS (ANALOG_CHNLS+1)   //IR sensors and the battery
+#define BATTERY   ANALOG_CHNLS      //sample index of the battery, after the IR sensors
+#define BRAKE_MS  500   //in ms, active brake after a crash, the back up waits for it, see ./robot_sim stop
+#define PIVOT_90  180   //encoder edges for a 90 degree pivot, pi*140/4 mm of wheel travel at 0.61 mm an edge
+#define BACK_EDGES 130  //encoder edges to back 80 mm away, out of ESTOP_DIST of what was hit
+#define SAMPLE_MS 10    //Timer A1 starts an ADC14 sequence this often
+#define SAMPLE_RING 8   //filtered samples main can fall behind by, 80 ms
+#define EVENT_RING  4   //collisions of each kind main can fall behind by
+#define STACK_PAINT 0xA5A5A5A5  //fills the unused stack, the deepest word changed is the high-water mark
+
+#ifndef PWM_HZ
+#define PWM_HZ     20000    //motor PWM, above hearing and easy to filter off the sensor supply
+#endif
+#ifndef RAMP_ACCEL
+#define RAMP_ACCEL 65536    //Q15 duty/s, 0 to 20% in 100 ms, the motor time constant
+#endif
+#ifndef RAMP_JERK
+#define RAMP_JERK  1310720  //Q15 duty/s^2, full acceleration in 50 ms
+#endif
 
 bool debug_mode = true;
-uint32_t ADCflag;
-uint8_t CollisionData, CollisionFlag;
+bool brake_mode = true;     //short the motors on a crash instead of letting them coast
+bool sysid_mode = false;    //measure the motors for tools/fit_motor.c instead of driving, needs RCR_SYSID defined
+volatile uint8_t Maneuvering;   //backing away from a crash, set until the motion queue is done
+volatile uint8_t estop_armed = (1 << ANALOG_CHNLS) - 1;   //IR sensors that can stop the motors, one stop until they read clear again
+
+uint32_t raw_adc_vals[ADC_CHNLS] = {0,0,0,0};    //[0] = right, [1] = center, [2] = left, [3] = battery
+uint32_t adc_capture[2][ADC_CHNLS];              //raw samples handed from the ADC14 task to PendSV, by turns
+volatile uint32_t adc_captures;                  //sequences captured, number n is in adc_capture[n&1]
+uint32_t adc_processed;                          //sequences PendSV has filtered, catches up to adc_captures
+uint32_t adc_skipped;                            //captures overwritten before PendSV got to them
+uint16_t estop_adc_vals[ADC_CHNLS];              //ESTOP_DIST for each sensor in ADC counts, 0 for the battery
+
+const adc_chnl_desc Analog_Inputs[ADC_CHNLS] = {    //analog channel, port, pin, index, sample time
+    {17, 9, 0, RIGHT,  ADC_SHT_96},     //P9.0
+    {14, 6, 1, CENTER, ADC_SHT_96},     //P6.1
+    {16, 9, 1, LEFT,   ADC_SHT_96},     //P9.1
+    {BATT_CHNL, 6, 0, BATTERY, ADC_SHT_96}   //P6.0
+};
+
+const filter_config IR_Filters[ANALOG_CHNLS] = {   //type, alpha(Q15), median size, see tools/filter_report.c
+    {FILTER_BOXCAR, 0, 0},              //right, FILTER_SIZE in RCR_IRDistance.h
+    {FILTER_BOXCAR, 0, 0},              //center
+    {FILTER_BOXCAR, 0, 0}               //left
+};
+
+// backing away from a crash, then turning toward the open side
+const motion_seg Back_Up     = {-100, -100, 1500, BACK_EDGES, 0};   //left, right(mm/s), ms, edges, until
+const motion_seg Pivot_Right = { 100, -100, 1500, PIVOT_90, 0};     //time limits in case a wheel stalls
+const motion_seg Pivot_Left  = {-100,  100, 1500, PIVOT_90, 0};
+
+#ifdef RCR_SYSID
+// duty steps for sysid_mode, from a stop up past the deadband to most of full power and back
+const sysid_step ID_Steps[] = {
+    {    0, 200}, { 1500, 600}, { 3000, 600}, { 6000, 600},
+    {10000, 600}, {14000, 600}, {18000, 600}, {    0, 600}
+};
+#endif
+
+// one filtered sample from PendSV, in mm
+struct Sensor_Sample {
+    uint32_t right, center, left;
+};
+typedef struct Sensor_Sample sensor_sample;
+
+// the newest filtered sample, all channels from the same sequence
+struct Sensor_Snapshot {
+    uint32_t right, center, left;   //mm
+    uint32_t ms;                    //when the sequence was sampled
+};
+typedef struct Sensor_Snapshot sensor_snapshot;
+
+// a crash, or an obstacle too close to wait for the filter
+struct Collision_Event {
+    uint8_t  bump;              //bump switches pressed, 0 for the IR window
+    uint8_t  ir;                //IR sensors over ESTOP_DIST, bit per sample index
+};
+typedef struct Collision_Event collision_event;
+
+// each ring has one producer, so the bump and ADC14 interrupts get one each
+sensor_sample   Sample_Buf[SAMPLE_RING];
+collision_event Bump_Buf[EVENT_RING], Estop_Buf[EVENT_RING];
+ring Sample_Ring;               //PendSV to Sample_Task
+ring Bump_Ring;                 //PORT4 to Control_Task
+ring Estop_Ring;                //ADC14 window to Control_Task
+
+sensor_snapshot Sensor_Now;     //behind Sensor_Lock, only Seqlock_Write touches it
+seqlock Sensor_Lock;            //PendSV to Control_Task and Display_Task
+
+uint64_t idle_last;             //Sched_Idle at the last report
+uint32_t ticks_last;            //Sched_Ticks at the last report
+uint32_t cpu_load;              //percent of the time since the last report the CPU was awake
+uint32_t stack_used;            //most bytes of stack in use since reset with every interrupt nested on it, read it with the debugger
+uint32_t nav_closest;           //closest reading in any sample since the last tick
+
+void Sample_Task(void);
+void Control_Task(void);
+void Display_Task(void);
+void Telemetry_Task(void);
 
-uint32_t raw_adc_vals[ANALOG_CHNLS] = {0,0,0};   //[0] = right, [1] = center, [2] = left
-uint32_t right_filt  = 0;
-uint32_t center_filt = 0;
-uint32_t left_filt   = 0;
+// run from the main loop, one tick is a 10 ms ADC sample, budgets are bus cycles at 48 MHz
+const sched_task Main_Tasks[] = {      //name, task, period, phase, priority, budget
+    {"sample",    &Sample_Task,    1,          0,  0,  2400},     //50 us
+    {"control",   &Control_Task,   1,          0,  1,  9600},     //200 us
+    {"display",   &Display_Task,   DISP_RATE,  0,  2,  240000},   //5 ms
+    {"telemetry", &Telemetry_Task, TELEM_RATE, 30, 3,  96000}     //2 ms, away from the display
+};
 
 
 void Handle_Collision(uint8_t bumpSensor) {     //immediately turn off motors if there is a crash
-   Motor_Stop();
-   CollisionData = bumpSensor;
-   CollisionFlag = 1;
+   collision_event e = {0, 0};
+   if(brake_mode) Motor_Brake(0,0,BRAKE_MS);
+   else Motor_Stop();
+   SysID_Abort();                               //or the next step drives back into it
+   e.bump = bumpSensor;
+   Ring_Put(&Bump_Ring,&e);
+}
+
+void Handle_Close_Obstacle(uint32_t irSensors) {   //stop before the filter catches up with a sudden obstacle
+   collision_event e = {0, 0};
+   irSensors &= estop_armed;                    //the window trips every sample the obstacle stays close
+   if(!irSensors) return;
+   estop_armed &= ~irSensors;                   //re-armed by Process_ADC_Samples once it reads clear
+   if(brake_mode) Motor_Brake(0,0,BRAKE_MS);
+   else Motor_Stop();
+   SysID_Abort();
+   e.ir = irSensors;
+   Ring_Put(&Estop_Ring,&e);
+}
+
+void Maneuver_Done(void) {      //motion queue ran out, navigation takes over again
+    Maneuvering = 0;
+}
+
+#ifdef RCR_SYSID
+void SysID_Done(void) {         //last step ended or a crash cut the run short, let main run again after this interrupt
+    SCB->SCR &= ~0x00000002;    //clear SLEEPONEXIT
+}
+#endif
+
+#if defined(__TI_ARM_V7M4__)
+extern uint32_t __STACK_END;    //from the linker, top of the stack
+extern uint32_t __STACK_SIZE;   //its address is the --stack_size setting
+
+void Stack_Paint(void) {        //first thing in main, fills the stack below this frame
+    uint32_t* p = (uint32_t*)((uint32_t)&__STACK_END - (uint32_t)&__STACK_SIZE);
+    uint32_t* sp = (uint32_t*)&p - 16;      //room for this function's own frame
+    while(p < sp) *p++ = STACK_PAINT;
+}
+
+uint32_t Stack_Used(void) {     //bytes from the top of the stack down to the deepest word changed
+    uint32_t* p = (uint32_t*)((uint32_t)&__STACK_END - (uint32_t)&__STACK_SIZE);
+    while(p < &__STACK_END && *p == STACK_PAINT) p++;
+    return (uint32_t)&__STACK_END - (uint32_t)p;
+}
+#else
+void Stack_Paint(void) {}       //the host sim runs on its own stack and doesn't nest frames like the CPU
+uint32_t Stack_Used(void) { return 0; }
+#endif
+
+void Capture_ADC_Samples(void) {        //ADC14 task at priority 1, only copies the samples out
+    uint32_t start = SysTick->VAL;
+    uint32_t* buf = adc_capture[adc_captures & 1];
+    int i;
+    for(i = 0; i < ADC_CHNLS; i++) buf[i] = raw_adc_vals[i];
+    adc_captures++;
+    PendSV_Pend(start);                 //filter and convert once no other interrupt is running
 }
 
-void Process_ADC_Samples(void) {        //collect samples, run them through filter, and convert to distance
-    ADC_In17_14_16(&raw_adc_vals[RIGHT],&raw_adc_vals[CENTER],&raw_adc_vals[LEFT]);
-    right_filt  = LowPassFilter(RIGHT,raw_adc_vals[RIGHT]);
-    center_filt = LowPassFilter(CENTER,raw_adc_vals[CENTER]);
-    left_filt   = LowPassFilter(LEFT,raw_adc_vals[LEFT]);
-    right_filt  = ConvertDist(right_filt);
-    center_filt = ConvertDist(center_filt);
-    left_filt   = ConvertDist(left_filt);
-    ADCflag = 1;
+void Process_Capture(uint32_t n) {      //one sequence, so the filter and the scheduler see every 10 ms
+    const uint32_t* raw = adc_capture[n & 1];
+    uint32_t dist[ANALOG_CHNLS];
+    uint8_t clear = 0;
+    sensor_sample s;
+    sensor_snapshot snap;
+    long sr;
+    int i;
+    for(i = 0; i < ANALOG_CHNLS; i++) {
+        if(raw[i] <= estop_adc_vals[i]) clear |= 1 << i;
+    }
+    if(clear & ~estop_armed) {          //the ADC14 interrupt writes it too
+        sr = StartCritical();
+        estop_armed |= clear;
+        EndCritical(sr);
+    }
+    LowPassFilter_All(raw,dist);
+    ConvertDist_All(dist,dist);
+    s.right  = snap.right  = dist[RIGHT];
+    s.center = snap.center = dist[CENTER];
+    s.left   = snap.left   = dist[LEFT];
+    snap.ms  = (n + 1)*SAMPLE_MS;
+    Ring_Put(&Sample_Ring,&s);          //dropped and counted if main is 80 ms behind
+    Seqlock_Write(&Sensor_Lock,&snap);
+    Motor_SetSupply(Battery_Update(raw[BATTERY]));
+    Sched_Tick();
+}
+
+void Process_ADC_Samples(void) {        //PendSV, run every capture since the last run through filter and convert to distance
+    uint32_t seq = adc_captures;
+    if(seq - adc_processed > 2) {       //only the newest two are still in the buffers
+        adc_skipped  += seq - adc_processed - 2;
+        adc_processed = seq - 2;
+    }
+    while(adc_processed != seq) Process_Capture(adc_processed++);
+}
+
+void Sample_Task(void) {        //take every sample since the last tick for the stop check
+    sensor_sample s;
+    nav_closest = 0xFFFFFFFF;
+    while(Ring_Get(&Sample_Ring,&s)) {
+        if(s.right  < nav_closest) nav_closest = s.right;
+        if(s.center < nav_closest) nav_closest = s.center;
+        if(s.left   < nav_closest) nav_closest = s.left;
+    }
+}
+
+void Navigate(const sensor_snapshot* snap, uint8_t stop, uint8_t crashed) {     //every decision from one sample period
+    //handle any potential or actual crashes by stopping and reversing
+    if(crashed && Maneuvering) {            //the interrupt stopped the motors partway, start over from here
+        Motion_Clear();
+        Maneuvering = 0;
+    }
+    if(stop || crashed) {
+        if(!Maneuvering) {                  //the motion queue times the whole maneuver
+            Maneuvering = 1;
+            Motion_Add(&Back_Up);
+            Motion_Add((snap->left > snap->right) ? &Pivot_Left : &Pivot_Right);
+        }
+    }                          //need logic to handle tight spaces that cycle between if else block
+    else if(!Maneuvering) {  //rudimentary navigation that directs the car to take path of least obstacles
+        if(snap->center > snap->right && snap->center > snap->left) Motor_SetSpeed(120,120);
+        else if(snap->right > snap->center && snap->right > snap->left) Motor_SetSpeed(108,-52);
+        else if(snap->left > snap->center && snap->left > snap->right) Motor_SetSpeed(-52,108);
+    }
+}
+
+void Control_Task(void) {
+    collision_event e;
+    sensor_snapshot snap;
+    uint8_t crashed = 0;
+    while(Ring_Get(&Bump_Ring,&e)) crashed = 1;     //every event is taken, none can be cleared unseen
+    while(Ring_Get(&Estop_Ring,&e)) crashed = 1;
+    Seqlock_Read(&Sensor_Lock,&snap);
+    Navigate(&snap,nav_closest < STOP_DIST,crashed);
+}
+
+void Display_Task(void) {       //display all IR sensor data on LCD screen
+    sensor_snapshot snap;
+    if(!debug_mode) return;
+    Seqlock_Read(&Sensor_Lock,&snap);
+    LaunchPad_LED(1);
+    LCD_ClrSection(DATA_X,DATA_X+20,0,0);
+    LCD_ClrSection(DATA_X,DATA_X+20,2,2);
+    LCD_ClrSection(DATA_X,DATA_X+20,4,4);
+    LCD_ClrSection(DATA_X,DATA_X+20,5,5);
+    LCD_SetCursor(DATA_X,0);        //displays every 600 ms
+    LCD_OutUInt(snap.right);
+    LCD_SetCursor(DATA_X,2);
+    LCD_OutUInt(snap.center);
+    LCD_SetCursor(DATA_X,4);
+    LCD_OutUInt(snap.left);
+    LCD_SetCursor(DATA_X,5);
+    LCD_OutUInt((Motor_Compensation()*100 + 2048) >> 12);
+    LaunchPad_LED(0);
+}
+
+void Telemetry_Task(void) {     //CPU load, scheduler overruns and dropped samples, 0 while every task fits
+    uint64_t idle = Sched_Idle();
+    uint32_t ticks = Sched_Ticks();
+    uint64_t window = (uint64_t)(ticks - ticks_last)*TICK_CYCLES;   //the first report is only its phase after Sched_Init
+    uint64_t asleep = idle - idle_last;
+    if(window) cpu_load = (asleep >= window) ? 0 : 100 - (uint32_t)(asleep*100/window);
+    stack_used = Stack_Used();
+    idle_last  = idle;
+    ticks_last = ticks;
+    if(!debug_mode) return;
+    LCD_ClrSection(DATA_X,DATA_X+20,1,1);
+    LCD_SetCursor(DATA_X,1);
+    LCD_OutUInt(cpu_load);
+    LCD_ClrSection(DATA_X,DATA_X+20,3,3);
+    LCD_SetCursor(DATA_X,3);
+    LCD_OutUInt(Sched_Overruns() + Ring_Overruns(&Sample_Ring));
 }
 
 void main(void) {
-    int num_samples = 0;
+    Stack_Paint();
     Clock_Init48MHz();
     LCD_Init();
     LaunchPad_Init();
     SysTick_Init();
-    ADCflag = 0;
-    CollisionFlag = 0;
-    ADC0_Init_Ch17_14_16();
-    ADC_In17_14_16(&raw_adc_vals[RIGHT],&raw_adc_vals[CENTER],&raw_adc_vals[LEFT]);
-    LowPassFilter_Init(ANALOG_CHNLS,64,raw_adc_vals);   //the larger the filter size, the more accurate the sample
-    TimerA1_Init(&Process_ADC_Samples,1875);     //every 10 ms
-    Motor_Init();
+    Ring_Init(&Sample_Ring,Sample_Buf,sizeof(sensor_sample),SAMPLE_RING);
+    Ring_Init(&Bump_Ring,Bump_Buf,sizeof(collision_event),EVENT_RING);
+    Ring_Init(&Estop_Ring,Estop_Buf,sizeof(collision_event),EVENT_RING);
+    Seqlock_Init(&Sensor_Lock,&Sensor_Now,sizeof(sensor_snapshot));
+    PendSV_Init(&Process_ADC_Samples);
+    ADC0_InitTask(Analog_Inputs,ADC_CHNLS,raw_adc_vals,&Capture_ADC_Samples);
+    ADC_In(raw_adc_vals);
+    LowPassFilter_Init(raw_adc_vals,IR_Filters);
+    Battery_Init(raw_adc_vals[BATTERY]);
+    estop_adc_vals[RIGHT]  = ConvertADC(ESTOP_DIST);
+    estop_adc_vals[CENTER] = ConvertADC(ESTOP_DIST);
+    estop_adc_vals[LEFT]   = ConvertADC(ESTOP_DIST);
+    ADC_InitWindow(&Handle_Close_Obstacle,estop_adc_vals);
+    TimerA1_Init(&ADC_Start,1875);       //every 10 ms
+    Motor_Init(PWM_HZ);
+    Motor_SetSupply(Battery_mV());
+    Motor_SetRamp(RAMP_ACCEL,RAMP_JERK);
+    Tach_Init();
+    Motion_Init(&Maneuver_Done);
     Bump_Init(&Handle_Collision);
 
+#ifdef RCR_SYSID
+    if(sysid_mode) {        //needs a clear metre straight ahead, a crash ends the run with what it has logged
+        Motor_SetRamp(0,0);
+        SysID_Start(ID_Steps,sizeof(ID_Steps)/sizeof(ID_Steps[0]),&SysID_Done);
+        SCB->SCR |= 0x00000002;     //SLEEPONEXIT, only interrupts run until SysID_Done
+        EnableInterrupts();
+        while(SysID_Busy()) WaitForInterrupt();     //the host has no sleep on exit
+        LaunchPad_LED(1);   //done, save SysID_Buffer with the debugger
+        while(1) WaitForInterrupt();
+    }
+#endif
+
     LCD_SetCursor(5,0);
     LCD_WriteStr("Right: ");
     LCD_SetCursor(65,0);
     LCD_WriteStr(" mm");
+    LCD_SetCursor(5,1);
+    LCD_WriteStr("CPU: ");      //load over the last second
+    LCD_SetCursor(65,1);
+    LCD_WriteStr(" %");
     LCD_SetCursor(5,2);
     LCD_WriteStr("Center: ");
     LCD_SetCursor(65,2);
     LCD_WriteStr(" mm");
+    LCD_SetCursor(5,3);
+    LCD_WriteStr("Ovr: ");      //scheduler overruns and dropped samples
     LCD_SetCursor(5,4);
     LCD_WriteStr("Left: ");
     LCD_SetCursor(65,4);
     LCD_WriteStr(" mm");
+    LCD_SetCursor(5,5);
+    LCD_WriteStr("Duty: ");     //battery compensation
+    LCD_SetCursor(65,5);
+    LCD_WriteStr(" %");
 
-    Motor_Forward(5000,5000);   //start at 33% speed
+    Motor_SetSpeed(200,200);    //start at 200 mm/s, the speed loop evens out the wheels
     LaunchPad_LED(0);
+    Sched_Init(Main_Tasks,sizeof(Main_Tasks)/sizeof(Main_Tasks[0]));
+    idle_last  = Sched_Idle();      //the first CPU load report starts here
+    ticks_last = Sched_Ticks();
     EnableInterrupts();
     while(1) {
-        if(ADCflag == 1) {  //will have to turn this logic into a state machine
-            ADCflag = 0;
-            //handle any potential or actual crashes by stopping and reversing
-            if(right_filt < STOP_DIST || center_filt < STOP_DIST || left_filt < STOP_DIST || CollisionFlag) {
-                if(Motor_Direction() != BACKWARD) {
-                    Motor_Stop();    //don't stop if we're already reversing
-                    Motor_Backward(1500,2000);
-                }
-                CollisionFlag = 0;                  //POTENTIAL BUG FOUND
-            }                          //need logic to handle tight spaces that cycle between if else block
-            else {  //rudimentary navigation that directs the car to take path of least obstacles
-                if(center_filt > right_filt && center_filt > left_filt) Motor_Forward(3000,3000);
-                else if(right_filt > center_filt && right_filt > left_filt) Motor_Right(2700,1300);
-                else if(left_filt > center_filt && left_filt > right_filt) Motor_Left(1300,2700);
-            }
-            num_samples++;
-        }
-        if(num_samples == DISP_RATE && debug_mode) {     //display all IR sensor data on LCD screen
-            LaunchPad_LED(1);
-            //will need semaphore
-            LCD_ClrSection(DATA_X,DATA_X+20,0,0);
-            LCD_ClrSection(DATA_X,DATA_X+20,2,2);
-            LCD_ClrSection(DATA_X,DATA_X+20,4,4);
-            LCD_SetCursor(DATA_X,0);        //displays every 600 ms
-            LCD_OutUInt(right_filt);
-            LCD_SetCursor(DATA_X,2);
-            LCD_OutUInt(center_filt);
-            LCD_SetCursor(DATA_X,4);
-            LCD_OutUInt(left_filt);
-
-            num_samples = 0;
-            LaunchPad_LED(0);
-        }
+        if(!Sched_Run()) Sched_Sleep();     //LPM0 until the next interrupt when there's nothing to run
     }
 }
@@ -0,0 +1,32 @@
+// Clock.c
+// Host stand-in, not part of the MSP432 build
+// Abhi Kallur
+
+// Host version of Clock.c. Changing the clock tells
+// host/sim.c how fast time passes per CPU cycle, and the
+// delays pass simulated time instead of spinning.
+
+
+#include <stdint.h>
+#include "Clock.h"
+#include "sim.h"
+
+uint32_t ClockFrequency = 3000000;      // cycles/second
+
+
+void Clock_Init48MHz(void) {
+    ClockFrequency = 48000000;
+    Sim_SetClock(48000000,12000000);    //MCLK = 48 MHz, SMCLK = 12 MHz
+}
+
+uint32_t Clock_GetFreq(void) {
+    return ClockFrequency;
+}
+
+void Clock_Delay1us(uint32_t n) {
+    Sim_Wait((uint64_t)n*(ClockFrequency/1000000));
+}
+
+void Clock_Delay1ms(uint32_t n) {
+    Sim_Wait((uint64_t)n*(ClockFrequency/1000));
+}
@@ -0,0 +1,46 @@
+// CortexM.c
+// Host stand-in, not part of the MSP432 build
+// Abhi Kallur
+
+// Host version of CortexM.c. The PRIMASK bit and WFI are
+// kept by host/sim.c, so critical sections and sleeping
+// work the same as on the LaunchPad.
+
+
+#include <stdint.h>
+#include "CortexM.h"
+#include "sim.h"
+
+
+void DisableInterrupts(void) {
+    Sim_Interrupts(1);
+}
+
+void EnableInterrupts(void) {
+    Sim_Interrupts(0);
+}
+
+long StartCritical(void) {
+    return Sim_Interrupts(1);
+}
+
+void EndCritical(long sr) {
+    Sim_Interrupts(sr != 0);
+}
+
+void WaitForInterrupt(void) {
+    Sim_WaitForInterrupt();
+}
+
+// CMSIS versions
+void __disable_irq(void) {
+    Sim_Interrupts(1);
+}
+
+void __enable_irq(void) {
+    Sim_Interrupts(0);
+}
+
+void __WFI(void) {
+    Sim_WaitForInterrupt();
+}
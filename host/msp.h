@@ -0,0 +1,324 @@
+// msp.h
+// Host stand-in, not part of the MSP432 build
+// Abhi Kallur
+
+// Replaces the MSP432P401R device header when the firmware
+// is built on a Linux box with -Ihost. Only the peripherals
+// the RCR drivers use are here, with the same register and
+// field names as the TI header so every RCR_*.c file builds
+// unchanged.
+//
+// All registers live in one block of memory owned by
+// host/sim.c. The block is locked while firmware runs, so
+// every register access traps into the simulator, which
+// gives it the same side effects as the real hardware.
+// See host/sim.h.
+
+
+#ifndef MSP_H_
+#define MSP_H_
+
+#include <stdint.h>
+
+#define __I     volatile        //not const, host/sim.c writes read-only registers
+#define __O     volatile
+#define __IO    volatile
+
+
+// Digital I/O, every port has every register so the
+// odd/even port types of the TI header aren't needed
+struct DIO_Port
+{
+    __I  uint8_t  IN;
+    __IO uint8_t  OUT;
+    __IO uint8_t  DIR;
+    __IO uint8_t  REN;
+    __IO uint8_t  DS;
+    __IO uint8_t  SEL0;
+    __IO uint8_t  SEL1;
+    __IO uint8_t  SELC;
+    __IO uint8_t  IES;
+    __IO uint8_t  IE;
+    __IO uint8_t  IFG;
+    __I  uint8_t  RESERVED0;
+    __I  uint16_t IV;
+};
+
+typedef struct DIO_Port DIO_PORT_Interruptable_Type;
+
+
+struct ADC14_Regs
+{
+    __IO uint32_t CTL0;
+    __IO uint32_t CTL1;
+    __IO uint32_t LO0;
+    __IO uint32_t HI0;
+    __IO uint32_t LO1;
+    __IO uint32_t HI1;
+    __IO uint32_t MCTL[32];
+    __IO uint32_t MEM[32];
+    __I  uint32_t RESERVED0[9];
+    __IO uint32_t IER0;
+    __IO uint32_t IER1;
+    __I  uint32_t IFGR0;
+    __I  uint32_t IFGR1;
+    __O  uint32_t CLRIFGR0;
+    __IO uint32_t CLRIFGR1;
+    __I  uint32_t IV;
+};
+
+typedef struct ADC14_Regs ADC14_Type;
+
+
+struct Timer_A_Regs
+{
+    __IO uint16_t CTL;
+    __IO uint16_t CCTL[7];
+    __IO uint16_t R;
+    __IO uint16_t CCR[7];
+    __IO uint16_t EX0;
+    __I  uint16_t RESERVED0[6];
+    __I  uint16_t IV;
+};
+
+typedef struct Timer_A_Regs Timer_A_Type;
+
+
+struct EUSCI_A_Regs
+{
+    __IO uint16_t CTLW0;
+    __IO uint16_t CTLW1;
+    __I  uint16_t RESERVED0;
+    __IO uint16_t BRW;
+    __IO uint16_t MCTLW;
+    __IO uint16_t STATW;
+    __I  uint16_t RXBUF;
+    __IO uint16_t TXBUF;
+    __IO uint16_t ABCTL;
+    __IO uint16_t IRTCTL;
+    __IO uint16_t IRRCTL;
+    __I  uint16_t RESERVED1[3];
+    __IO uint16_t IE;
+    __IO uint16_t IFG;
+    __I  uint16_t IV;
+};
+
+typedef struct EUSCI_A_Regs EUSCI_A_Type;
+
+
+struct DMA_Control_Regs
+{
+    __I  uint32_t STAT;
+    __O  uint32_t CFG;
+    __IO uint32_t CTLBASE;
+    __I  uint32_t ALTBASE;
+    __I  uint32_t WAITSTAT;
+    __O  uint32_t SWREQ;
+    __IO uint32_t USEBURSTSET;
+    __O  uint32_t USEBURSTCLR;
+    __IO uint32_t REQMASKSET;
+    __O  uint32_t REQMASKCLR;
+    __IO uint32_t ENASET;
+    __O  uint32_t ENACLR;
+    __IO uint32_t ALTSET;
+    __O  uint32_t ALTCLR;
+    __IO uint32_t PRIOSET;
+    __O  uint32_t PRIOCLR;
+    __I  uint32_t RESERVED0[3];
+    __IO uint32_t ERRCLR;
+};
+
+typedef struct DMA_Control_Regs DMA_Control_Type;
+
+
+struct DMA_Channel_Regs
+{
+    __I  uint32_t DEVICE_CFG;
+    __IO uint32_t SW_CHTRIG;
+    __I  uint32_t RESERVED0[2];
+    __IO uint32_t CH_SRCCFG[32];
+    __I  uint32_t RESERVED1[28];
+    __IO uint32_t INT1_SRCCFG;
+    __IO uint32_t INT2_SRCCFG;
+    __IO uint32_t INT3_SRCCFG;
+    __I  uint32_t RESERVED2;
+    __I  uint32_t INT0_SRCFLG;
+    __O  uint32_t INT0_CLRFLG;
+};
+
+typedef struct DMA_Channel_Regs DMA_Channel_Type;
+
+
+struct NVIC_Regs
+{
+    __IO uint32_t ISER[8];
+    __IO uint32_t ICER[8];
+    __IO uint32_t ISPR[8];
+    __IO uint32_t ICPR[8];
+    __IO uint32_t IABR[8];
+    __IO uint8_t  IP[240];
+    __O  uint32_t STIR;
+};
+
+typedef struct NVIC_Regs NVIC_Type;
+
+
+struct SCB_Regs
+{
+    __I  uint32_t CPUID;
+    __IO uint32_t ICSR;
+    __IO uint32_t VTOR;
+    __IO uint32_t AIRCR;
+    __IO uint32_t SCR;
+    __IO uint32_t CCR;
+    __IO uint8_t  SHP[12];
+    __IO uint32_t SHCSR;
+    __IO uint32_t CPACR;
+};
+
+typedef struct SCB_Regs SCB_Type;
+
+
+struct SysTick_Regs
+{
+    __IO uint32_t CTRL;
+    __IO uint32_t LOAD;
+    __IO uint32_t VAL;
+    __I  uint32_t CALIB;
+};
+
+typedef struct SysTick_Regs SysTick_Type;
+
+
+struct DWT_Regs
+{
+    __IO uint32_t CTRL;
+    __IO uint32_t CYCCNT;
+};
+
+typedef struct DWT_Regs DWT_Type;
+
+
+// every simulated register, in the block host/sim.c traps on
+struct Sim_Periph
+{
+    DIO_PORT_Interruptable_Type port[11];  //P1-P10, PJ
+    ADC14_Type       adc14;
+    Timer_A_Type     timer_a[4];
+    EUSCI_A_Type     eusci_a3;
+    DMA_Control_Type dma_control;
+    DMA_Channel_Type dma_channel;
+    NVIC_Type        nvic;
+    SCB_Type         scb;
+    SysTick_Type     systick;
+    DWT_Type         dwt;
+};
+
+extern struct Sim_Periph* Sim_Regs;         //register block
+extern volatile uint8_t*  Sim_BitBand;      //bit-band alias of the register block
+
+
+#define P1          (&Sim_Regs->port[0])
+#define P2          (&Sim_Regs->port[1])
+#define P3          (&Sim_Regs->port[2])
+#define P4          (&Sim_Regs->port[3])
+#define P5          (&Sim_Regs->port[4])
+#define P6          (&Sim_Regs->port[5])
+#define P7          (&Sim_Regs->port[6])
+#define P8          (&Sim_Regs->port[7])
+#define P9          (&Sim_Regs->port[8])
+#define P10         (&Sim_Regs->port[9])
+#define PJ          (&Sim_Regs->port[10])
+#define ADC14       (&Sim_Regs->adc14)
+#define TIMER_A0    (&Sim_Regs->timer_a[0])
+#define TIMER_A1    (&Sim_Regs->timer_a[1])
+#define TIMER_A2    (&Sim_Regs->timer_a[2])
+#define TIMER_A3    (&Sim_Regs->timer_a[3])
+#define EUSCI_A3    (&Sim_Regs->eusci_a3)
+#define DMA_Control (&Sim_Regs->dma_control)
+#define DMA_Channel (&Sim_Regs->dma_channel)
+#define NVIC        (&Sim_Regs->nvic)
+#define SCB         (&Sim_Regs->scb)
+#define SysTick     (&Sim_Regs->systick)
+#define DWT         (&Sim_Regs->dwt)
+
+// same alias math as the TI header, so the simulator can tell which bit was touched
+#define BITBAND_PERI(x, b)  (*((__IO uint32_t *)(Sim_BitBand + ((uintptr_t)&(x) - (uintptr_t)Sim_Regs)*32 + (b)*4)))
+
+
+// legacy Timer A register names
+#define TA0CTL      (TIMER_A0->CTL)
+#define TA0CCTL0    (TIMER_A0->CCTL[0])
+#define TA0CCTL1    (TIMER_A0->CCTL[1])
+#define TA0CCTL2    (TIMER_A0->CCTL[2])
+#define TA0CCTL3    (TIMER_A0->CCTL[3])
+#define TA0CCTL4    (TIMER_A0->CCTL[4])
+#define TA0CCTL5    (TIMER_A0->CCTL[5])
+#define TA0CCTL6    (TIMER_A0->CCTL[6])
+#define TA0R        (TIMER_A0->R)
+#define TA0CCR0     (TIMER_A0->CCR[0])
+#define TA0CCR1     (TIMER_A0->CCR[1])
+#define TA0CCR2     (TIMER_A0->CCR[2])
+#define TA0CCR3     (TIMER_A0->CCR[3])
+#define TA0CCR4     (TIMER_A0->CCR[4])
+#define TA0CCR5     (TIMER_A0->CCR[5])
+#define TA0CCR6     (TIMER_A0->CCR[6])
+#define TA0EX0      (TIMER_A0->EX0)
+#define TA0IV       (TIMER_A0->IV)
+
+#define TA1CTL      (TIMER_A1->CTL)
+#define TA1CCTL0    (TIMER_A1->CCTL[0])
+#define TA1CCTL1    (TIMER_A1->CCTL[1])
+#define TA1CCTL2    (TIMER_A1->CCTL[2])
+#define TA1CCTL3    (TIMER_A1->CCTL[3])
+#define TA1CCTL4    (TIMER_A1->CCTL[4])
+#define TA1R        (TIMER_A1->R)
+#define TA1CCR0     (TIMER_A1->CCR[0])
+#define TA1CCR1     (TIMER_A1->CCR[1])
+#define TA1CCR2     (TIMER_A1->CCR[2])
+#define TA1CCR3     (TIMER_A1->CCR[3])
+#define TA1CCR4     (TIMER_A1->CCR[4])
+#define TA1EX0      (TIMER_A1->EX0)
+#define TA1IV       (TIMER_A1->IV)
+
+#define TA2CTL      (TIMER_A2->CTL)
+#define TA2CCTL0    (TIMER_A2->CCTL[0])
+#define TA2CCTL1    (TIMER_A2->CCTL[1])
+#define TA2CCTL2    (TIMER_A2->CCTL[2])
+#define TA2CCTL3    (TIMER_A2->CCTL[3])
+#define TA2CCTL4    (TIMER_A2->CCTL[4])
+#define TA2R        (TIMER_A2->R)
+#define TA2CCR0     (TIMER_A2->CCR[0])
+#define TA2CCR1     (TIMER_A2->CCR[1])
+#define TA2CCR2     (TIMER_A2->CCR[2])
+#define TA2CCR3     (TIMER_A2->CCR[3])
+#define TA2CCR4     (TIMER_A2->CCR[4])
+#define TA2EX0      (TIMER_A2->EX0)
+#define TA2IV       (TIMER_A2->IV)
+
+#define TA3CTL      (TIMER_A3->CTL)
+#define TA3CCTL0    (TIMER_A3->CCTL[0])
+#define TA3CCTL1    (TIMER_A3->CCTL[1])
+#define TA3CCTL2    (TIMER_A3->CCTL[2])
+#define TA3CCTL3    (TIMER_A3->CCTL[3])
+#define TA3CCTL4    (TIMER_A3->CCTL[4])
+#define TA3R        (TIMER_A3->R)
+#define TA3CCR0     (TIMER_A3->CCR[0])
+#define TA3CCR1     (TIMER_A3->CCR[1])
+#define TA3CCR2     (TIMER_A3->CCR[2])
+#define TA3CCR3     (TIMER_A3->CCR[3])
+#define TA3CCR4     (TIMER_A3->CCR[4])
+#define TA3EX0      (TIMER_A3->EX0)
+#define TA3IV       (TIMER_A3->IV)
+
+
+// CMSIS intrinsics the drivers use
+void __WFI(void);
+void __enable_irq(void);
+void __disable_irq(void);
+
+// a full barrier, so RCR_Ring.c is also safe between host threads
+#define __DMB()     __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+
+#endif
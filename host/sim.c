@@ -0,0 +1,888 @@
+// sim.c
+// Host stand-in, not part of the MSP432 build
+// Abhi Kallur
+
+// Simulates the MSP432 peripherals the RCR drivers use so
+// the firmware can run on a Linux(x86-64) box. See sim.h
+// for what is modeled.
+//
+// The register block and its bit-band alias are mapped with
+// no access. A firmware access raises SIGSEGV, the fault
+// handler brings time up to date, unlocks the block and
+// single-steps the instruction with the trap flag. SIGTRAP
+// then compares the block to its copy from before the access
+// to see what was written, applies the side effects, locks
+// the block again and takes any pending interrupts. SIGALRM
+// moves time along when the firmware only touches RAM and
+// calls the sensor hook.
+
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include "msp.h"
+#include "sim.h"
+
+
+#define ACCESS_CYCLES  4            //CPU cycles per register access
+#define STEP_US        10           //time between interrupt checks when time is passed in bulk
+#define TICK_US        1000         //real time between SIGALRMs
+#define TRAP_FLAG      0x100        //x86 EFLAGS.TF
+#define ACLK           32768
+
+#define ADC_SC         0x00000001
+#define ADC_ENC        0x00000002
+#define ADC_ON         0x00000010
+#define ADC_MSC        0x00000080
+#define ADC_BUSY       0x00010000
+#define ADC_EOS        0x00000080
+#define ADC_WINC       0x00004000
+#define ADC_WINCTH     0x00008000
+
+#define TA_TAIFG       0x0001
+#define TA_TAIE        0x0002
+#define TA_TACLR       0x0004
+#define TA_CCIFG       0x0001
+#define TA_CCIE        0x0010
+#define TA_CAP         0x0100
+#define TA_COV         0x0002
+#define TA_CCRS        5            //CCR0-CCR4 on the MSP432
+
+#define UC_SWRST       0x0001
+#define UC_BUSY        0x0001
+#define UC_TXIFG       0x0002
+
+#define ST_ENABLE      0x00000001
+#define ST_TICKINT     0x00000002
+#define ST_COUNTFLAG   0x00010000
+#define PENDSVSET      0x10000000
+#define PENDSVCLR      0x08000000
+
+#define IRQ_SYSTICK    (-1)
+#define IRQ_PENDSV     (-2)
+
+#define REG(field)     offsetof(struct Sim_Periph, field)
+#define IN_REG(off, field)  ((off) >= REG(field) && (off) < REG(field) + sizeof(((struct Sim_Periph*)0)->field))
+
+
+// ISRs the firmware might define, missing ones are null
+#define WEAK __attribute__((weak))
+void WEAK SysTick_Handler(void);
+void WEAK PendSV_Handler(void);
+void WEAK TA0_0_IRQHandler(void);
+void WEAK TA0_N_IRQHandler(void);
+void WEAK TA1_0_IRQHandler(void);
+void WEAK TA1_N_IRQHandler(void);
+void WEAK TA2_0_IRQHandler(void);
+void WEAK TA2_N_IRQHandler(void);
+void WEAK TA3_0_IRQHandler(void);
+void WEAK TA3_N_IRQHandler(void);
+void WEAK ADC14_IRQHandler(void);
+void WEAK DMA_INT1_IRQHandler(void);
+void WEAK PORT1_IRQHandler(void);
+void WEAK PORT2_IRQHandler(void);
+void WEAK PORT3_IRQHandler(void);
+void WEAK PORT4_IRQHandler(void);
+void WEAK PORT5_IRQHandler(void);
+void WEAK PORT6_IRQHandler(void);
+
+
+struct Sim_Vector
+{
+    int32_t   irq;
+    void      (*handler)(void);
+};
+
+typedef struct Sim_Vector sim_vector;
+
+static const sim_vector Vectors[] = {
+    {IRQ_PENDSV,  PendSV_Handler},
+    {IRQ_SYSTICK, SysTick_Handler},
+    {8,  TA0_0_IRQHandler},
+    {9,  TA0_N_IRQHandler},
+    {10, TA1_0_IRQHandler},
+    {11, TA1_N_IRQHandler},
+    {12, TA2_0_IRQHandler},
+    {13, TA2_N_IRQHandler},
+    {14, TA3_0_IRQHandler},
+    {15, TA3_N_IRQHandler},
+    {24, ADC14_IRQHandler},
+    {33, DMA_INT1_IRQHandler},
+    {35, PORT1_IRQHandler},
+    {36, PORT2_IRQHandler},
+    {37, PORT3_IRQHandler},
+    {38, PORT4_IRQHandler},
+    {39, PORT5_IRQHandler},
+    {40, PORT6_IRQHandler}
+};
+
+#define NUM_VECTORS (sizeof(Vectors)/sizeof(Vectors[0]))
+
+
+struct Sim_Periph* Sim_Regs;
+volatile uint8_t*  Sim_BitBand;
+
+static size_t    Regs_Size, Alias_Size;
+static struct Sim_Periph Before;        //register block before the trapped access
+static uintptr_t Access_Addr;
+static uint32_t  Accesses;
+static sigset_t  Access_Mask;           //signal mask of the trapped code
+
+static volatile sig_atomic_t Primask, In_ISR, Unlocked;    //In_ISR counts the nested ISRs
+static uint32_t  Active_Pri = 8;        //priority of the running ISR, 8 in main code
+static int32_t   Nest[8], Deepest[8];   //IRQs of the running ISRs, and at the deepest nesting so far
+static uint32_t  Nest_Max;
+static uint32_t  IRQ_Count[NUM_VECTORS];
+static bool      SysTick_Pending, PendSV_Pending;
+
+static uint64_t  Cycles;
+static uint32_t  MCLK = 3000000, SMCLK = 3000000;
+static uint64_t  SMCLK_Acc, ACLK_Acc;
+
+static uint32_t  Timer_Acc[4];
+static bool      Timer_Down[4];
+
+static uint16_t  Analog[32];
+static bool      Adc_Active, Adc_In_Seq;
+static uint32_t  Adc_Chnl, Adc_Ticks;
+
+static bool      Spi_Shifting;
+static int32_t   Spi_Buff = -1;
+static uint32_t  Spi_Ticks;
+
+#define NUM_WAVES      4
+
+struct Sim_Wave                         //square wave driven on an input pin
+{
+    uint32_t  port, pin;
+    double    half;                     //CPU cycles between edges, 0 when off
+    double    next;                     //Cycles at the next edge
+};
+
+typedef struct Sim_Wave sim_wave;
+
+static sim_wave  Waves[NUM_WAVES];
+
+static void      (*Hook)(uint32_t ms);
+static uint32_t  Hook_ms, Speed;
+static uint64_t  Next_Hook;
+
+
+static void Sim_Lock(void) {
+    mprotect(Sim_Regs,Regs_Size,PROT_NONE);
+    mprotect((void*)Sim_BitBand,Alias_Size,PROT_NONE);
+    Unlocked = 0;
+}
+
+static void Sim_Unlock(void) {
+    mprotect(Sim_Regs,Regs_Size,PROT_READ | PROT_WRITE);
+    mprotect((void*)Sim_BitBand,Alias_Size,PROT_READ | PROT_WRITE);
+    Unlocked = 1;
+}
+
+// keep SIGALRM out while the simulator runs from main code
+static void Sim_Enter(sigset_t* old) {
+    sigset_t alrm;
+    sigemptyset(&alrm);
+    sigaddset(&alrm,SIGALRM);
+    sigprocmask(SIG_BLOCK,&alrm,old);
+    Sim_Unlock();
+}
+
+static void Sim_Leave(sigset_t* old) {
+    Sim_Lock();
+    sigprocmask(SIG_SETMASK,old,0);
+}
+
+
+/*
+  Timer A
+  ----------------------------------------------------------------------
+  Each count compares R to every CCR in compare mode. TA1.1 in reset/set
+  mode goes high at CCR0, which is ADC14 trigger source 3.
+*/
+static void Adc_Trigger(uint32_t source);
+
+static uint32_t Timer_IV(uint32_t t) {
+    Timer_A_Type* ta = &Sim_Regs->timer_a[t];
+    uint32_t n;
+    for(n = 1; n < TA_CCRS; n++)
+    {
+        if((ta->CCTL[n] & (TA_CCIE | TA_CCIFG)) == (TA_CCIE | TA_CCIFG)) return 2*n;
+    }
+    if((ta->CTL & (TA_TAIE | TA_TAIFG)) == (TA_TAIE | TA_TAIFG)) return 0x0E;
+    return 0;
+}
+
+static void Timer_Count(uint32_t t, uint32_t mode) {
+    Timer_A_Type* ta = &Sim_Regs->timer_a[t];
+    uint16_t r = ta->R;
+    uint32_t n;
+    switch(mode)
+    {
+        case 1:                                 //up to CCR0
+            if(r >= ta->CCR[0]) { r = 0; ta->CTL |= TA_TAIFG; }
+            else r++;
+            break;
+        case 2:                                 //continuous
+            if(++r == 0) ta->CTL |= TA_TAIFG;
+            break;
+        default:                                //up/down
+            if(Timer_Down[t])
+            {
+                if(r) r--;
+                if(r == 0) { Timer_Down[t] = false; ta->CTL |= TA_TAIFG; }
+            }
+            else if(++r >= ta->CCR[0]) Timer_Down[t] = true;
+            break;
+    }
+    ta->R = r;
+    for(n = 0; n < TA_CCRS; n++)
+    {
+        if(!(ta->CCTL[n] & TA_CAP) && r == ta->CCR[n]) ta->CCTL[n] |= TA_CCIFG;
+    }
+    if(t == 1 && r == ta->CCR[0] && ((ta->CCTL[1] >> 5) & 7) == 7) Adc_Trigger(3);
+}
+
+static void Timer_Run(uint32_t t, uint32_t smclk, uint32_t aclk) {
+    Timer_A_Type* ta = &Sim_Regs->timer_a[t];
+    uint32_t mode = (ta->CTL >> 4) & 3;
+    uint32_t ssel = (ta->CTL >> 8) & 3;
+    uint32_t div  = (1 << ((ta->CTL >> 6) & 3))*((ta->EX0 & 7) + 1);
+    uint32_t counts;
+    if(mode == 0) return;                       //stopped
+    Timer_Acc[t] += (ssel == 1) ? aclk : (ssel == 2) ? smclk : 0;
+    counts        = Timer_Acc[t]/div;
+    Timer_Acc[t] -= counts*div;
+    while(counts--) Timer_Count(t,mode);
+}
+
+
+/*
+  ADC14
+  ----------------------------------------------------------------------
+  A conversion takes its sample time plus 16 clocks of SMCLK. MSC runs
+  the rest of the sequence without more triggers.
+*/
+static const uint16_t Adc_SHT[8] = {4, 8, 16, 32, 64, 96, 128, 192};
+
+static uint32_t Adc_Conv_Ticks(uint32_t i) {
+    uint32_t sht = (i >= 8 && i <= 23) ? (Sim_Regs->adc14.CTL0 >> 12) : (Sim_Regs->adc14.CTL0 >> 8);
+    return Adc_SHT[sht & 7] + 16;
+}
+
+static void Adc_Trigger(uint32_t source) {
+    ADC14_Type* adc = &Sim_Regs->adc14;
+    uint32_t conseq = (adc->CTL0 >> 17) & 3;
+    if((adc->CTL0 & (ADC_ON | ADC_ENC)) != (ADC_ON | ADC_ENC)) return;
+    if(((adc->CTL0 >> 27) & 7) != source || Adc_Active) return;
+    if(!Adc_In_Seq || conseq == 0 || conseq == 2) Adc_Chnl = (adc->CTL1 >> 16) & 0x1F;
+    Adc_In_Seq = true;
+    Adc_Active = true;
+    Adc_Ticks  = Adc_Conv_Ticks(Adc_Chnl);
+    adc->CTL0 |= ADC_BUSY;
+}
+
+static void Adc_Convert(uint32_t i) {
+    ADC14_Type* adc = &Sim_Regs->adc14;
+    uint32_t mctl = adc->MCTL[i];
+    uint32_t val  = Analog[mctl & 0x1F];
+    adc->MEM[i]   = val;
+    adc->IFGR0   |= 1 << i;
+    if(mctl & ADC_WINC)
+    {
+        uint32_t hi = (mctl & ADC_WINCTH) ? adc->HI1 : adc->HI0;
+        uint32_t lo = (mctl & ADC_WINCTH) ? adc->LO1 : adc->LO0;
+        adc->IFGR1 |= (val > hi) ? 0x08 : (val < lo) ? 0x04 : 0x02;   //HIIFG, LOIFG, INIFG
+    }
+}
+
+static void Adc_Run(uint32_t ticks) {
+    ADC14_Type* adc = &Sim_Regs->adc14;
+    uint32_t conseq = (adc->CTL0 >> 17) & 3;
+    bool eos;
+    while(Adc_Active)
+    {
+        if(ticks < Adc_Ticks) { Adc_Ticks -= ticks; break; }
+        ticks -= Adc_Ticks;
+        Adc_Convert(Adc_Chnl);
+        eos = (conseq == 0 || conseq == 2 || (adc->MCTL[Adc_Chnl] & ADC_EOS));
+        if(eos) Adc_Chnl = (adc->CTL1 >> 16) & 0x1F;
+        else Adc_Chnl = (Adc_Chnl + 1) & 0x1F;
+        if(eos && conseq < 2) Adc_In_Seq = false;
+        if((eos && conseq < 2) || !(adc->CTL0 & ADC_MSC) || !(adc->CTL0 & ADC_ENC)) Adc_Active = false;
+        else Adc_Ticks = Adc_Conv_Ticks(Adc_Chnl);
+    }
+    if(Adc_Active) adc->CTL0 |= ADC_BUSY;
+    else adc->CTL0 &= ~ADC_BUSY;
+}
+
+
+/*
+  EUSCI_A3
+  ----------------------------------------------------------------------
+  SPI master, a byte takes 8 bit clocks of SMCLK/BRW. TXBUF is free
+  again as soon as its byte moves into the shift register.
+*/
+static void Spi_Write(void) {
+    EUSCI_A_Type* spi = &Sim_Regs->eusci_a3;
+    if(spi->CTLW0 & UC_SWRST) return;
+    if(Spi_Shifting)
+    {
+        Spi_Buff  = spi->TXBUF & 0xFF;
+        spi->IFG &= ~UC_TXIFG;
+        return;
+    }
+    Spi_Shifting = true;
+    Spi_Ticks    = 8*(spi->BRW ? spi->BRW : 1);
+    spi->STATW  |= UC_BUSY;
+}
+
+static void Spi_Run(uint32_t ticks) {
+    EUSCI_A_Type* spi = &Sim_Regs->eusci_a3;
+    while(Spi_Shifting)
+    {
+        if(ticks < Spi_Ticks) { Spi_Ticks -= ticks; break; }
+        ticks -= Spi_Ticks;
+        if(Spi_Buff >= 0)
+        {
+            Spi_Buff   = -1;
+            Spi_Ticks  = 8*(spi->BRW ? spi->BRW : 1);
+            spi->IFG  |= UC_TXIFG;
+        }
+        else
+        {
+            Spi_Shifting = false;
+            spi->STATW  &= ~UC_BUSY;
+        }
+    }
+}
+
+
+/*
+  Ports, SysTick
+  ----------------------------------------------------------------------
+  An edge on a pin that's a Timer A capture input copies R into the
+  CCR, like P10.4 and P10.5 into TA3CCR0 and TA3CCR1.
+*/
+struct Sim_Capture
+{
+    uint8_t   port, pin, timer, ccr;
+};
+
+static const struct Sim_Capture Captures[] = {
+    {1, 4, 0, 1}, {1, 5, 0, 2}, {1, 6, 0, 3}, {1, 7, 0, 4},   //P2.4-P2.7, TA0.1-TA0.4
+    {6, 7, 1, 1}, {6, 6, 1, 2}, {6, 5, 1, 3}, {6, 4, 1, 4},   //P7.7-P7.4, TA1.1-TA1.4
+    {9, 4, 3, 0}, {9, 5, 3, 1}, {7, 2, 3, 2}, {8, 2, 3, 3}    //P10.4, P10.5, P8.2, P9.2, TA3.0-TA3.3
+};
+
+static void Timer_Capture(uint32_t port, uint32_t pin, bool rising) {
+    uint32_t i, cm;
+    Timer_A_Type* ta;
+    for(i = 0; i < sizeof(Captures)/sizeof(Captures[0]); i++)
+    {
+        if(Captures[i].port != port || Captures[i].pin != pin) continue;
+        if(!(Sim_Regs->port[port].SEL0 & (1 << pin)) || (Sim_Regs->port[port].SEL1 & (1 << pin))) return;
+        ta = &Sim_Regs->timer_a[Captures[i].timer];
+        cm = ta->CCTL[Captures[i].ccr] >> 14;
+        if(!(ta->CCTL[Captures[i].ccr] & TA_CAP) || ((ta->CCTL[Captures[i].ccr] >> 12) & 3)) return;   //CCIxA only
+        if(!(cm & (rising ? 1 : 2))) return;
+        if(ta->CCTL[Captures[i].ccr] & TA_CCIFG) ta->CCTL[Captures[i].ccr] |= TA_COV;
+        ta->CCR[Captures[i].ccr]   = ta->R;
+        ta->CCTL[Captures[i].ccr] |= TA_CCIFG;
+        return;
+    }
+}
+
+static void Pin_Change(uint32_t port, uint32_t pin, uint32_t level) {
+    DIO_PORT_Interruptable_Type* p = &Sim_Regs->port[port];
+    uint8_t bit = 1 << pin;
+    if(((p->IN & bit) != 0) == (level != 0)) return;
+    p->IN ^= bit;
+    if(port < 6 && ((level == 0) == ((p->IES & bit) != 0))) p->IFG |= bit;
+    Timer_Capture(port,pin,level != 0);
+}
+
+static uint32_t Port_IV(uint32_t p) {
+    uint32_t pend = Sim_Regs->port[p].IFG & Sim_Regs->port[p].IE;
+    uint32_t pin;
+    for(pin = 0; pin < 8; pin++)
+    {
+        if(pend & (1 << pin)) return 2*(pin + 1);
+    }
+    return 0;
+}
+
+static void SysTick_Run(uint64_t cycles) {
+    SysTick_Type* st = &Sim_Regs->systick;
+    uint32_t load = st->LOAD & 0x00FFFFFF;
+    if(!(st->CTRL & ST_ENABLE)) return;
+    while(cycles)
+    {
+        if(st->VAL == 0)                        //reload takes a clock
+        {
+            if(load == 0) return;
+            st->VAL = load;
+            cycles--;
+            continue;
+        }
+        if(cycles < st->VAL) { st->VAL -= cycles; return; }
+        cycles  -= st->VAL;
+        st->VAL  = 0;
+        st->CTRL |= ST_COUNTFLAG;
+        if(st->CTRL & ST_TICKINT) SysTick_Pending = true;
+    }
+}
+
+
+/*
+  Sim_Advance
+  ----------------------------------------------------------------------
+  Move every peripheral forward by some CPU cycles, stopping at each
+  edge of a wave from Sim_SetWave so captures see the right count.
+*/
+static void Periph_Advance(uint64_t cycles) {
+    uint32_t smclk, aclk, t;
+    Cycles += cycles;
+    if(Sim_Regs->dwt.CTRL & 1) Sim_Regs->dwt.CYCCNT += cycles;
+    SysTick_Run(cycles);
+
+    SMCLK_Acc += cycles*SMCLK;
+    ACLK_Acc  += cycles*ACLK;
+    smclk      = SMCLK_Acc/MCLK;
+    aclk       = ACLK_Acc/MCLK;
+    SMCLK_Acc -= (uint64_t)smclk*MCLK;
+    ACLK_Acc  -= (uint64_t)aclk*MCLK;
+
+    for(t = 0; t < 4; t++) Timer_Run(t,smclk,aclk);
+    Adc_Run(smclk);
+    Spi_Run(smclk);
+}
+
+static void Sim_Advance(uint64_t cycles) {
+    uint64_t end = Cycles + cycles, edge;
+    sim_wave* w;
+    uint32_t i;
+    while(1)
+    {
+        for(w = 0, i = 0; i < NUM_WAVES; i++)
+        {
+            if(Waves[i].half > 0 && (!w || Waves[i].next < w->next)) w = &Waves[i];
+        }
+        edge = w ? (uint64_t)w->next : end;
+        if(!w || edge >= end) break;
+        if(edge > Cycles) Periph_Advance(edge - Cycles);
+        Pin_Change(w->port,w->pin,!(Sim_Regs->port[w->port].IN & (1 << w->pin)));
+        w->next += w->half;
+    }
+    Periph_Advance(end - Cycles);
+}
+
+
+/*
+  Sim_Dispatch
+  ----------------------------------------------------------------------
+  Take pending interrupts in priority order until none are left that
+  can preempt the running ISR, if any. Called with the register block
+  unlocked. The ISR runs with it locked, and an access it makes can
+  take a higher priority interrupt on top of it like on the CPU.
+*/
+static bool Sim_Pending(int32_t irq) {
+    ADC14_Type* adc = &Sim_Regs->adc14;
+    if(irq == IRQ_SYSTICK) return SysTick_Pending;
+    if(irq == IRQ_PENDSV) return PendSV_Pending;
+    if(!(Sim_Regs->nvic.ISER[irq >> 5] & (1 << (irq & 31)))) return false;
+    if(irq >= 8 && irq <= 15)
+    {
+        if(irq & 1) return Timer_IV((irq - 8)/2) != 0;
+        return (Sim_Regs->timer_a[(irq - 8)/2].CCTL[0] & (TA_CCIE | TA_CCIFG)) == (TA_CCIE | TA_CCIFG);
+    }
+    if(irq == 24) return (adc->IFGR0 & adc->IER0) || (adc->IFGR1 & adc->IER1);
+    if(irq >= 35 && irq <= 40) return Port_IV(irq - 35) != 0;
+    return false;
+}
+
+static uint32_t Sim_Priority(int32_t irq) {
+    if(irq == IRQ_SYSTICK) return Sim_Regs->scb.SHP[11] >> 5;
+    if(irq == IRQ_PENDSV) return Sim_Regs->scb.SHP[10] >> 5;
+    return Sim_Regs->nvic.IP[irq] >> 5;
+}
+
+static int32_t Sim_Next(void) {
+    uint32_t i, pri, best_pri = 8;
+    int32_t best = -1;
+    for(i = 0; i < NUM_VECTORS; i++)
+    {
+        if(!Vectors[i].handler || !Sim_Pending(Vectors[i].irq)) continue;
+        pri = Sim_Priority(Vectors[i].irq);
+        if(pri < best_pri) { best = i; best_pri = pri; }
+    }
+    return best;
+}
+
+static void Sim_Dispatch(void) {
+    uint32_t was = Active_Pri;
+    int32_t i;
+    if(Primask) return;
+    while((i = Sim_Next()) >= 0 && Sim_Priority(Vectors[i].irq) < was)
+    {
+        if(Vectors[i].irq == IRQ_SYSTICK) SysTick_Pending = false;
+        if(Vectors[i].irq == IRQ_PENDSV) PendSV_Pending = false;
+        IRQ_Count[i]++;
+        Active_Pri = Sim_Priority(Vectors[i].irq);
+        Nest[In_ISR] = Vectors[i].irq;
+        In_ISR = In_ISR + 1;
+        if((uint32_t)In_ISR > Nest_Max)
+        {
+            Nest_Max = In_ISR;
+            memcpy(Deepest,Nest,sizeof(Nest));
+        }
+        Sim_Lock();
+        (*Vectors[i].handler)();
+        Sim_Unlock();
+        In_ISR = In_ISR - 1;
+        Active_Pri = was;
+    }
+}
+
+// pass time in steps, taking interrupts and calling the hook in between
+static void Sim_Run(uint64_t cycles) {
+    uint64_t step = (uint64_t)MCLK*STEP_US/1000000;
+    while(cycles)
+    {
+        if(step > cycles) step = cycles;
+        Sim_Advance(step);
+        cycles -= step;
+        while(Hook && Cycles >= Next_Hook)
+        {
+            Next_Hook += MCLK/1000;
+            (*Hook)(++Hook_ms);
+        }
+        Sim_Dispatch();
+    }
+}
+
+
+/*
+  Sim_Before, Sim_After
+  ----------------------------------------------------------------------
+  Side effects of a register access at an offset in the block. Sim_Before
+  sets up what a read returns. Sim_After sees what was written by
+  comparing to the copy from before and also handles reads that clear
+  flags. Bits the hardware owns are put back after a write.
+*/
+static void Sim_Before(uintptr_t off) {
+    uint32_t i;
+    for(i = 0; i < 6; i++)
+    {
+        if(IN_REG(off,port[i].IV)) Sim_Regs->port[i].IV = Port_IV(i);
+    }
+    for(i = 0; i < 4; i++)
+    {
+        if(IN_REG(off,timer_a[i].IV)) Sim_Regs->timer_a[i].IV = Timer_IV(i);
+    }
+    if(IN_REG(off,scb.ICSR)) Sim_Regs->scb.ICSR = PendSV_Pending ? PENDSVSET : 0;
+}
+
+static void Sim_After(uintptr_t off) {
+    struct Sim_Periph* r = Sim_Regs;
+    uint32_t i, iv;
+
+    for(i = 0; i < 6; i++)                      //reading IV clears its flag
+    {
+        if(IN_REG(off,port[i].IV) && Before.port[i].IV) r->port[i].IFG &= ~(1 << (Before.port[i].IV/2 - 1));
+    }
+
+    if(IN_REG(off,adc14.CTL0))
+    {
+        r->adc14.CTL0 = (r->adc14.CTL0 & ~ADC_BUSY) | (Adc_Active ? ADC_BUSY : 0);
+        if(!(r->adc14.CTL0 & ADC_ENC)) Adc_In_Seq = false;
+        if(r->adc14.CTL0 & ADC_SC)
+        {
+            r->adc14.CTL0 &= ~ADC_SC;
+            Adc_Trigger(0);
+        }
+    }
+    if(IN_REG(off,adc14.MEM)) r->adc14.IFGR0 &= ~(1 << ((off - REG(adc14.MEM))/4));
+    if(IN_REG(off,adc14.CLRIFGR0))
+    {
+        r->adc14.IFGR0   &= ~r->adc14.CLRIFGR0;
+        r->adc14.CLRIFGR0 = 0;
+    }
+    if(IN_REG(off,adc14.CLRIFGR1))
+    {
+        r->adc14.IFGR1   &= ~r->adc14.CLRIFGR1;
+        r->adc14.CLRIFGR1 = 0;
+    }
+
+    for(i = 0; i < 4; i++)
+    {
+        if(IN_REG(off,timer_a[i].CTL) && (r->timer_a[i].CTL & TA_TACLR))
+        {
+            r->timer_a[i].CTL &= ~TA_TACLR;
+            r->timer_a[i].R    = 0;
+            Timer_Acc[i]       = 0;
+            Timer_Down[i]      = false;
+        }
+        if(IN_REG(off,timer_a[i].IV) && (iv = Before.timer_a[i].IV))
+        {
+            if(iv == 0x0E) r->timer_a[i].CTL &= ~TA_TAIFG;
+            else r->timer_a[i].CCTL[iv/2] &= ~TA_CCIFG;
+        }
+    }
+
+    if(IN_REG(off,eusci_a3.CTLW0))
+    {
+        if((r->eusci_a3.CTLW0 ^ Before.eusci_a3.CTLW0) & UC_SWRST) r->eusci_a3.IFG |= UC_TXIFG;
+        if(r->eusci_a3.CTLW0 & UC_SWRST) { Spi_Shifting = false; Spi_Buff = -1; }
+    }
+    if(IN_REG(off,eusci_a3.STATW)) r->eusci_a3.STATW = (r->eusci_a3.STATW & ~UC_BUSY) | (Spi_Shifting ? UC_BUSY : 0);
+    if(IN_REG(off,eusci_a3.TXBUF)) Spi_Write();
+
+    if(IN_REG(off,systick.VAL) && r->systick.VAL != Before.systick.VAL)
+    {
+        r->systick.VAL   = 0;                   //any write clears it
+        r->systick.CTRL &= ~ST_COUNTFLAG;
+    }
+    if(IN_REG(off,systick.CTRL) && (Before.systick.CTRL & ST_COUNTFLAG)) r->systick.CTRL &= ~ST_COUNTFLAG;
+
+    for(i = 0; i < 8; i++)
+    {
+        if(IN_REG(off,nvic.ISER[i])) r->nvic.ISER[i] |= Before.nvic.ISER[i];     //writing 0 does nothing
+        if(IN_REG(off,nvic.ICER[i])) r->nvic.ISER[i] = Before.nvic.ISER[i] & ~r->nvic.ICER[i];
+        r->nvic.ICER[i] = r->nvic.ISER[i];      //both read back the enables
+    }
+    if(IN_REG(off,scb.ICSR))
+    {
+        if(r->scb.ICSR & PENDSVSET) PendSV_Pending = true;
+        if(r->scb.ICSR & PENDSVCLR) PendSV_Pending = false;
+        r->scb.ICSR = PendSV_Pending ? PENDSVSET : 0;
+    }
+}
+
+
+/*
+  Sim_Fault, Sim_Trap, Sim_Tick
+  ----------------------------------------------------------------------
+  Signal handlers. SIGALRM is blocked in the fault handlers and while
+  the trapped instruction runs, and ISRs never see it.
+*/
+static void Sim_Fault(int sig, siginfo_t* info, void* context) {
+    ucontext_t* uc = context;
+    uintptr_t addr = (uintptr_t)info->si_addr;
+    uintptr_t off;
+    (void)sig;
+    if(addr - (uintptr_t)Sim_Regs >= Regs_Size && addr - (uintptr_t)Sim_BitBand >= Alias_Size)
+    {
+        signal(SIGSEGV,SIG_DFL);                //real crash, fault again with no handler
+        return;
+    }
+    Sim_Unlock();
+    if(!In_ISR) Accesses++;                    //main code is moving time by itself
+    Sim_Advance(ACCESS_CYCLES);
+    if(addr - (uintptr_t)Sim_BitBand < Alias_Size)
+    {
+        off = (addr - (uintptr_t)Sim_BitBand)/4;    //bit number in block
+        *(volatile uint32_t*)(Sim_BitBand + off*4) = (((volatile uint8_t*)Sim_Regs)[off/8] >> (off & 7)) & 1;
+    }
+    else Sim_Before(addr - (uintptr_t)Sim_Regs);
+    memcpy(&Before,(void*)Sim_Regs,sizeof(Before));
+    Access_Addr = addr;
+    Access_Mask = uc->uc_sigmask;
+    sigaddset(&uc->uc_sigmask,SIGALRM);
+    uc->uc_mcontext.gregs[REG_EFL] |= TRAP_FLAG;
+}
+
+static void Sim_Trap(int sig, siginfo_t* info, void* context) {
+    ucontext_t* uc = context;
+    uintptr_t off;
+    (void)sig;
+    (void)info;
+    uc->uc_mcontext.gregs[REG_EFL] &= ~TRAP_FLAG;
+    uc->uc_sigmask = Access_Mask;
+    if(Access_Addr - (uintptr_t)Sim_BitBand < Alias_Size)
+    {
+        off = (Access_Addr - (uintptr_t)Sim_BitBand)/4;
+        if(*(volatile uint32_t*)(Sim_BitBand + off*4) & 1) ((volatile uint8_t*)Sim_Regs)[off/8] |= 1 << (off & 7);
+        else ((volatile uint8_t*)Sim_Regs)[off/8] &= ~(1 << (off & 7));
+    }
+    else Sim_After(Access_Addr - (uintptr_t)Sim_Regs);
+    Sim_Dispatch();
+    Sim_Lock();
+}
+
+// one-shot, re-armed after each tick so the firmware always gets
+// TICK_US of real time even when a tick runs longer than that
+static void Sim_Arm(void) {
+    struct itimerval tick;
+    tick.it_interval.tv_sec  = 0;
+    tick.it_interval.tv_usec = 0;
+    tick.it_value.tv_sec     = 0;
+    tick.it_value.tv_usec    = TICK_US;
+    setitimer(ITIMER_REAL,&tick,0);
+}
+
+static void Sim_Tick(int sig) {
+    static uint32_t last;
+    (void)sig;
+    if(Accesses == last)
+    {
+        Sim_Unlock();
+        Sim_Run((uint64_t)Speed*(MCLK/1000)*TICK_US/1000);
+        Sim_Lock();
+    }
+    last = Accesses;
+    Sim_Arm();
+}
+
+
+void Sim_Init(void(*hook)(uint32_t ms), uint32_t speed) {
+    struct sigaction act;
+    uint32_t i;
+    long page = sysconf(_SC_PAGESIZE);
+
+    Regs_Size   = (sizeof(struct Sim_Periph) + page - 1) & ~(page - 1);
+    Alias_Size  = Regs_Size*32;
+    Sim_Regs    = mmap(0,Regs_Size,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+    Sim_BitBand = mmap(0,Alias_Size,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+
+    for(i = 0; i < 11; i++) Sim_Regs->port[i].IN = 0xFF;    //inputs pulled up
+    Sim_Regs->eusci_a3.CTLW0 = UC_SWRST;
+    Sim_Regs->eusci_a3.IFG   = UC_TXIFG;
+    Hook      = hook;
+    Speed     = speed ? speed : 1;
+    Next_Hook = MCLK/1000;
+
+    memset(&act,0,sizeof(act));
+    act.sa_flags = SA_SIGINFO | SA_NODEFER;     //ISRs run from the handlers and trap too
+    sigemptyset(&act.sa_mask);
+    sigaddset(&act.sa_mask,SIGALRM);
+    act.sa_sigaction = Sim_Fault;
+    sigaction(SIGSEGV,&act,0);
+    act.sa_sigaction = Sim_Trap;
+    sigaction(SIGTRAP,&act,0);
+
+    memset(&act,0,sizeof(act));
+    act.sa_flags   = SA_RESTART;
+    act.sa_handler = Sim_Tick;
+    sigemptyset(&act.sa_mask);
+    sigaction(SIGALRM,&act,0);
+    Sim_Arm();
+
+    Sim_Lock();
+}
+
+
+void Sim_SetAnalog(uint32_t chnl, uint32_t value) {
+    Analog[chnl & 0x1F] = (value > 16383) ? 16383 : value;
+}
+
+
+void Sim_SetPin(uint32_t port, uint32_t pin, uint32_t level) {
+    sigset_t old;
+    bool locked = !Unlocked;                    //hooks run with the block unlocked
+    if(locked) Sim_Enter(&old);
+    Pin_Change(port,pin,level);
+    if(locked) Sim_Leave(&old);
+}
+
+
+void Sim_SetWave(uint32_t port, uint32_t pin, double hz) {
+    sigset_t old;
+    bool locked = !Unlocked;
+    sim_wave* w = 0;
+    double half = (hz > 0) ? MCLK/(2*hz) : 0;
+    uint32_t i;
+    if(locked) Sim_Enter(&old);
+    for(i = 0; i < NUM_WAVES; i++)
+    {
+        if(Waves[i].half > 0 && Waves[i].port == port && Waves[i].pin == pin) w = &Waves[i];
+    }
+    for(i = 0; !w && i < NUM_WAVES; i++)
+    {
+        if(Waves[i].half <= 0) w = &Waves[i];
+    }
+    if(w)
+    {
+        if(w->half > 0 && half > 0) w->next = Cycles + (w->next - Cycles)*half/w->half;   //keep the phase
+        else w->next = Cycles + half;
+        w->port = port;
+        w->pin  = pin;
+        w->half = half;
+    }
+    if(locked) Sim_Leave(&old);
+}
+
+
+uint64_t Sim_Time(void) {
+    return Cycles;
+}
+
+
+void Sim_SetClock(uint32_t mclk, uint32_t smclk) {
+    MCLK      = mclk;
+    SMCLK     = smclk;
+    SMCLK_Acc = 0;
+    ACLK_Acc  = 0;
+    Next_Hook = Cycles + MCLK/1000;
+}
+
+
+void Sim_Wait(uint64_t cycles) {
+    sigset_t old;
+    Sim_Enter(&old);
+    Sim_Run(cycles);
+    Sim_Leave(&old);
+}
+
+
+uint32_t Sim_Interrupts(uint32_t primask) {
+    sigset_t old;
+    uint32_t was = Primask;
+    Primask = primask;
+    if(!primask)
+    {
+        Sim_Enter(&old);
+        Sim_Dispatch();
+        Sim_Leave(&old);
+    }
+    return was;
+}
+
+
+void Sim_WaitForInterrupt(void) {
+    sigset_t old;
+    uint32_t i, before = 0, taken;
+    if(In_ISR) return;
+    Sim_Enter(&old);
+    for(i = 0; i < NUM_VECTORS; i++) before += IRQ_Count[i];
+    do
+    {
+        Sim_Run((uint64_t)MCLK*STEP_US/1000000);
+        for(taken = 0, i = 0; i < NUM_VECTORS; i++) taken += IRQ_Count[i];
+    } while(taken == before && Sim_Next() < 0);    //until an ISR ran, or one is pending but masked
+    Sim_Leave(&old);
+}
+
+
+uint32_t Sim_IRQCount(int32_t irq) {
+    uint32_t i;
+    for(i = 0; i < NUM_VECTORS; i++)
+    {
+        if(Vectors[i].irq == irq) return IRQ_Count[i];
+    }
+    return 0;
+}
+
+
+uint32_t Sim_Nesting(int32_t* irqs) {
+    memcpy(irqs,Deepest,Nest_Max*sizeof(Deepest[0]));
+    return Nest_Max;
+}
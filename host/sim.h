@@ -0,0 +1,172 @@
+// sim.h
+// Host stand-in, not part of the MSP432 build
+// Abhi Kallur
+
+// Simulates the MSP432 peripherals the RCR drivers use so
+// the firmware can run on a Linux(x86-64) box. How fast it
+// runs against real-time depends on how many interrupts the
+// firmware takes, robot_sim prints the ratio at the end.
+//
+// The register block from host/msp.h is kept locked. Each
+// register access the firmware makes faults, the simulator
+// updates any registers that depend on time, lets the one
+// instruction run, then applies what the access did:
+//   ADC14:    SC starts a sequence, BUSY is set until it's
+//             done, MEM and IFGR0 are filled at the end of
+//             each conversion, reading MEM clears its flag,
+//             window comparator sets IFGR1
+//   Timer A:  counts in up, continuous and up/down modes,
+//             sets CCIFG and TAIFG, reading IV clears a flag,
+//             TA1.1 in reset/set mode triggers the ADC14
+//   EUSCI_A3: TXBUF write shifts out 8 bits at BRW, with
+//             UCBUSY and TXIFG like SPI master mode
+//   Ports:    injected edges set IFG, IV is the lowest
+//             pending enabled pin, reading IV clears it,
+//             edges on Timer A pins capture R in CCIxA mode
+//   SysTick, DWT CYCCNT, NVIC enables and priorities,
+//   PendSV, and bit-band aliases of every register
+//
+// Interrupts are taken between instructions like on the
+// CPU. A timer signal keeps time moving while the firmware
+// only touches RAM. ISRs nest by NVIC priority, but a higher
+// priority one only gets in at a register access the running
+// one makes, so the nesting seen is a lower bound. The DMA
+// isn't modeled since the firmware writes 32-bit addresses
+// into it.
+//
+// Cycle counts are not a measurement of the firmware. Only
+// register accesses are charged, ACCESS_CYCLES in sim.c each,
+// and code that only touches RAM takes no simulated time. So
+// SysTick, DWT CYCCNT and anything timed with them, like the
+// RCR_Sched.c run times, RCR_PendSV.c latencies and the time
+// asleep, only count register accesses plus the time passed
+// by delays, WFI and the timer signal. Events happen in the
+// right order, but how many cycles a piece of code takes has
+// to be measured on the LaunchPad.
+
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdint.h>
+
+#define SIM_PORT1     0         //port numbers for Sim_SetPin
+#define SIM_PORT2     1
+#define SIM_PORT3     2
+#define SIM_PORT4     3
+#define SIM_PORT5     4
+#define SIM_PORT6     5
+#define SIM_PORT9     8
+#define SIM_PORT10    9
+
+
+/*
+  Sim_Init
+  ----------------------------------------------------------------------
+  Reset every register to its power on value, with the CPU at 3 MHz,
+  and lock the register block so firmware accesses trap. Every input
+  pin starts high, like a switch with a pull-up.
+
+  Parameters:   1) function called every ms of simulated time to inject
+                   sensor values, runs like an ISR, can be null
+                2) simulated ms per real ms
+  Return value: none
+*/
+void Sim_Init(void(*hook)(uint32_t ms), uint32_t speed);
+
+
+/*
+  Sim_SetAnalog
+  ----------------------------------------------------------------------
+  Set the voltage on an ADC14 analog input. The next conversion of that
+  channel gives this value.
+
+  Parameters:   1) analog channel, 0-31
+                2) 14-bit ADC value
+  Return value: none
+*/
+void Sim_SetAnalog(uint32_t chnl, uint32_t value);
+
+
+/*
+  Sim_SetPin
+  ----------------------------------------------------------------------
+  Drive an input pin. A change sets the pin's IFG if it's the edge
+  picked by IES.
+
+  Parameters:   1) port number, SIM_PORT1 to SIM_PORT6 can interrupt
+                2) pin, 0-7
+                3) level, 0 or 1
+  Return value: none
+*/
+void Sim_SetPin(uint32_t port, uint32_t pin, uint32_t level);
+
+
+/*
+  Sim_SetWave
+  ----------------------------------------------------------------------
+  Drive a square wave on an input pin, like an encoder. The edges land
+  on the exact CPU cycle, between the 1 ms hooks, so Timer A captures
+  measure the period. Changing the frequency keeps the phase.
+
+  Parameters:   1) port number, SIM_PORT1 to SIM_PORT10
+                2) pin, 0-7
+                3) frequency in Hz, 0 stops the wave and holds the pin
+  Return value: none
+*/
+void Sim_SetWave(uint32_t port, uint32_t pin, double hz);
+
+
+/*
+  Sim_Time, Sim_SetClock, Sim_Wait
+  ----------------------------------------------------------------------
+  Simulated time is counted in CPU cycles. Sim_SetClock is called by
+  the host Clock.c when the clock is changed. Sim_Wait passes time
+  without touching registers, taking interrupts, for delay loops.
+
+  Parameters:   1) CPU clock in Hz
+                2) SMCLK in Hz
+  Return value: CPU cycles since Sim_Init
+*/
+uint64_t Sim_Time(void);
+void Sim_SetClock(uint32_t mclk, uint32_t smclk);
+void Sim_Wait(uint64_t cycles);
+
+
+/*
+  Sim_Interrupts, Sim_WaitForInterrupt
+  ----------------------------------------------------------------------
+  Used by the host CortexM.c. Sim_Interrupts sets the PRIMASK bit and
+  returns the old one, taking any pending interrupts if it's cleared.
+  Sim_WaitForInterrupt passes time until an interrupt has been taken.
+
+  Parameters:   1) 1 to mask interrupts, 0 to enable them
+  Return value: old PRIMASK
+*/
+uint32_t Sim_Interrupts(uint32_t primask);
+void Sim_WaitForInterrupt(void);
+
+
+/*
+  Sim_IRQCount
+  ----------------------------------------------------------------------
+  Number of times an interrupt was taken, for benchmarks.
+
+  Parameters:   1) IRQ number, or -1 for SysTick and -2 for PendSV
+  Return value: count
+*/
+uint32_t Sim_IRQCount(int32_t irq);
+
+/*
+  Sim_Nesting
+  ----------------------------------------------------------------------
+  The deepest the ISRs have nested, for sizing the stack. Each level
+  is an exception frame on the CPU's stack.
+
+  Parameters:   1) array of 8 to take the IRQ numbers, the outermost
+                   first, -1 for SysTick and -2 for PendSV
+  Return value: number of ISRs that were running at once
+*/
+uint32_t Sim_Nesting(int32_t* irqs);
+
+#endif
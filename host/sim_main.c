@@ -0,0 +1,651 @@
+// sim_main.c
+// Host stand-in, not part of the MSP432 build
+// Abhi Kallur
+
+// Runs the whole firmware from RCR_main.c on a Linux(x86-64)
+// box against host/sim.c, with the robot driving around a
+// simulated room. The IR sensors see the walls and the bump
+// switches close when it runs into one. Each wheel is a DC
+// motor with a 100 ms time constant and some friction to
+// overcome, and its tire slips past WHEEL_GRIP. The left motor
+// is LEFT_GAIN weaker than the right like on a real robot. The encoders put square
+// waves on the Timer A3 pins. The motors run slower as the
+// battery drains from BATT_START, and it sags under load.
+// The motor PWM ripples the IR sensor supply through an RC
+// filter, so the IR noise depends on the PWM frequency. Prints the robot's state
+// every 500 ms and a benchmark at the end, with the motor
+// current, slip and settling time after direction reversals.
+// It leaves out the firmware's cycle counts, see sim.h for
+// why they aren't real.
+//
+// Build and run from the project folder:
+//   gcc -O2 -Ihost -I. -Dmain=Firmware_Main -DRCR_SYSID -o robot_sim host/*.c RCR_*.c LaunchPad.c -lm
+//   ./robot_sim [simulated ms] [simulated ms per real ms]
+//   ./robot_sim stop
+//   ./robot_sim speed
+//   ./robot_sim motion
+//   ./robot_sim sysid > capture.txt
+//   ./robot_sim sched
+//   ./robot_sim adc
+//
+// The last six skip the firmware's main. stop measures how far
+// the robot goes after Motor_Stop and after Motor_Brake, speed
+// times a reversal from 200 mm/s with and without the ramp,
+// compares a Motor_SetSpeed step to the same open loop duty,
+// and open loop duty on a low battery with and without the
+// battery compensation. motion runs a back up, pivot and
+// forward maneuver through the motion queue. sysid runs the motor
+// measurement from RCR_SysID.c and prints the log for
+// tools/fit_motor.c. sched drives RCR_Sched.c from a virtual
+// clock with made up task costs, one of them over its budget.
+// adc checks that the ADC0_InitTask task only runs once every
+// MEM of the sequence is latched.
+//
+// Add -DRAMP_ACCEL=0 to build without the motor ramp and compare,
+// or -DPWM_HZ=100 for the old PWM frequency.
+//
+// The firmware's main is renamed to Firmware_Main on the
+// command line, so this file undoes that for its own main.
+// Clock.c and CortexM.c are replaced by the host versions
+// in this folder.
+
+
+#undef main
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "msp.h"
+#include "sim.h"
+#include "RCR_IRDistance.h"
+#include "RCR_ADC14.h"
+#include "RCR_TimerA0.h"
+#include "RCR_Motor.h"
+#include "RCR_Tach.h"
+#include "RCR_Battery.h"
+#include "RCR_Motion.h"
+#include "RCR_SysID.h"
+#include "RCR_Sched.h"
+#include "RCR_PendSV.h"
+#include "RCR_Ring.h"
+#include "RCR_Seqlock.h"
+#include "RCR_SysTick.h"
+#include "Clock.h"
+#include "CortexM.h"
+
+#define ROOM_W      1200.0      //room size in mm
+#define ROOM_H      900.0
+#define ROBOT_R     70.0        //robot radius in mm
+#define WHEEL_BASE  140.0       //mm between wheels
+#define MAX_SPEED   600.0       //mm/s at 100% duty
+#define MOTOR_TAU   0.100       //s, motor time constant while driven
+#define COAST_TAU   0.300       //s, time constant while coasting
+#define WHEEL_GRIP  1000.0      //mm/s^2, tires slip past this
+#define LEFT_GAIN   0.9         //left motor speed per duty, right is 1
+#define LEFT_DEAD   0.06        //duty the left motor needs before it turns, friction
+#define RIGHT_DEAD  0.04
+#define BATT_START  8200.0      //mV, a fresh pack, MAX_SPEED is at MOTOR_NOMINAL_MV
+#define BATT_DRAIN  0.05        //mV lost per ms of driving, 1.5 V over 30 s
+#define BATT_SAG    1000.0      //mV dropped at stall current
+#define RIPPLE_ADC  200.0       //ADC counts of PWM ripple on the IR supply at full duty, before the filter
+#define RAIL_HZ     300.0       //corner of the RC filter on the IR supply
+#define SMCLK_HZ    12000000.0
+
+#ifndef PWM_HZ
+#define PWM_HZ      20000       //same as RCR_main.c
+#endif
+#define REPORT_MS   500
+
+#define PI          3.14159265358979
+#define EDGE_MM     (PI*WHEEL_DIAM/ENC_EDGES)   //mm per encoder edge
+
+void Firmware_Main(void);
+extern uint32_t raw_adc_vals[];
+extern uint32_t adc_skipped;
+extern const sched_task Main_Tasks[];
+extern ring Sample_Ring, Bump_Ring, Estop_Ring;
+extern seqlock Sensor_Lock;
+
+
+static const double Sensor_Angle[ANALOG_CHNLS] = {-PI/4, 0, PI/4};   //right, center, left
+static const uint32_t Sensor_Chnl[ANALOG_CHNLS] = {17, 14, 16};      //ADC14 channel of each sensor
+
+static double X = ROOM_W/2, Y = ROOM_H/2, Heading = 0;
+static double Dist[ANALOG_CHNLS];
+static uint32_t Sim_ms, Bumps, Bumped, Quiet;
+static double IR_Noise;         //sum of squared raw center IR errors, in ADC counts
+static uint32_t IR_Samples;
+
+// one wheel's motor and tire
+struct Wheel_Model {
+    double gain;                //speed per duty, 1 gives MAX_SPEED at 100%
+    double deadband;            //duty that only overcomes friction
+    double drive;               //speed the motor is driven toward, mm/s
+    double spin;                //wheel surface speed
+    double ground;              //speed over the floor, differs from spin when slipping
+    double peak_amps;           //peak current, fraction of stall current
+    double slip;                //mm slipped
+    uint32_t reverse_ms;        //start of the last direction reversal, 0 once settled
+    uint32_t settle_ms, settles;
+};
+typedef struct Wheel_Model wheel_model;
+
+static wheel_model Left  = {LEFT_GAIN,LEFT_DEAD,0,0,0,0,0,0,0,0};
+static wheel_model Right = {1.0,RIGHT_DEAD,0,0,0,0,0,0,0,0};
+static double Battery = MOTOR_NOMINAL_MV;   //mV with no load
+static double Slip_Yaw;         //heading error from slip that odometry can't see
+static struct timespec Start;
+
+
+// distance from the robot's edge to the wall along a ray
+static double Ray(double angle) {
+    double dx = cos(angle), dy = sin(angle);
+    double tx = (dx > 0) ? (ROOM_W - X)/dx : (dx < 0) ? -X/dx : 1e9;
+    double ty = (dy > 0) ? (ROOM_H - Y)/dy : (dy < 0) ? -Y/dy : 1e9;
+    return ((tx < ty) ? tx : ty) - ROBOT_R;
+}
+
+// Timer A0 period in clk cycles and its frequency
+static double PWM_Period(void) {
+    return TA0CCR0 + 1.0;
+}
+
+static double PWM_Freq(void) {
+    return SMCLK_HZ/(1 << ((TA0CTL >> 6) & 3))/((TA0EX0 & 7) + 1)/PWM_Period();
+}
+
+// duty on a PWM pin as a fraction, Motor_Brake takes them from the timer
+static double Duty(uint8_t pin, uint16_t ccr) {
+    if(P2->SEL0 & pin) return ccr/PWM_Period();
+    return (P2->OUT & pin) ? 1 : 0;
+}
+
+// advance a wheel 1 ms from the motor pins and duty
+static void Wheel(wheel_model* w, uint8_t enable, uint8_t backward, double duty, uint32_t ms) {
+    double over = duty*Battery/MOTOR_NOMINAL_MV - w->deadband;
+    double drive = (over > 0) ? (backward ? -MAX_SPEED : MAX_SPEED)*w->gain*over/(1 - w->deadband) : 0;
+    double was = w->spin, amps, step;
+
+    if(enable)
+    {
+        if(drive*w->drive < 0) w->reverse_ms = ms;
+        else if(w->reverse_ms && fabs(drive - w->drive) < 0.01*fabs(drive) + 1 && fabs(w->ground - drive) < 0.05*fabs(drive) + 2)
+        {
+            w->settle_ms += ms - w->reverse_ms;
+            w->settles++;
+            w->reverse_ms = 0;
+        }
+        amps = fabs(drive - w->spin)/MAX_SPEED;
+        if(amps > w->peak_amps) w->peak_amps = amps;
+        w->spin += (drive - w->spin)/MOTOR_TAU/1000;
+        w->drive = drive;
+    }
+    else w->spin -= w->spin/COAST_TAU/1000;
+
+    step = w->spin - w->ground;                 //the floor only takes WHEEL_GRIP
+    if(step >  WHEEL_GRIP/1000) step =  WHEEL_GRIP/1000;
+    if(step < -WHEEL_GRIP/1000) step = -WHEEL_GRIP/1000;
+    if(fabs(w->spin - was) <= WHEEL_GRIP/1000 && fabs(w->spin - w->ground) < 1) w->ground = w->spin;
+    else w->ground += step;
+    w->slip += fabs(w->spin - w->ground)/1000;
+}
+
+// encoder A edges on the Timer A3 pin, encoder B high going forward
+static void Encoder(const wheel_model* w, uint32_t pinA, uint32_t pinB) {
+    Sim_SetPin(SIM_PORT5,pinB,w->spin >= 0);
+    Sim_SetWave(SIM_PORT10,pinA,fabs(w->spin)/EDGE_MM);
+}
+
+static void Report(void) {
+    printf("%6u ms  x %5.0f y %5.0f heading %4.0f  IR %4.0f %4.0f %4.0f mm  motors %c%c duty %3.0f%% %3.0f%%  battery %4.0f mV x%.2f  bumps %u\n",
+           Sim_ms, X, Y, fmod(fmod(Heading*180/PI,360) + 360,360), Dist[0], Dist[1], Dist[2],
+           (P3->OUT & 0x80) ? ((P5->OUT & 0x10) ? 'B' : 'F') : '-',
+           (P3->OUT & 0x40) ? ((P5->OUT & 0x20) ? 'B' : 'F') : '-',
+           100*Duty(0x80,TA0CCR4), 100*Duty(0x40,TA0CCR3), Battery, Motor_Compensation()/4096.0, Bumps);
+}
+
+// deepest the ISRs nested, each level stacks an exception frame, 104 bytes
+// with the FPU state lazy stacking makes room for
+static void Nesting_Report(void) {
+    static const struct { int32_t irq; const char* name; } names[] = {
+        {-2,"PendSV"}, {-1,"SysTick"}, {8,"TA0_0"}, {9,"TA0_N"}, {10,"TA1_0"}, {11,"TA1_N"}, {12,"TA2_0"},
+        {13,"TA2_N"}, {14,"TA3_0"}, {15,"TA3_N"}, {24,"ADC14"}, {33,"DMA_INT1"}, {38,"PORT4"}
+    };
+    int32_t irqs[8];
+    uint32_t depth = Sim_Nesting(irqs), i, j;
+    printf("deepest ISR nesting: %u, %u bytes of exception frames,", depth, depth*104);
+    for(i = 0; i < depth; i++)
+    {
+        for(j = 0; j < sizeof(names)/sizeof(names[0]) && names[j].irq != irqs[i]; j++);
+        printf(" %s", (j < sizeof(names)/sizeof(names[0])) ? names[j].name : "?");
+    }
+    printf("\n");
+}
+
+static void Motor_Report(const char* name, const wheel_model* w) {
+    printf("%s wheel: peak current %3.0f%% of stall, slipped %5.0f mm, %3u reversals settled in %4.0f ms average\n",
+           name, w->peak_amps*100, w->slip, w->settles, w->settles ? (double)w->settle_ms/w->settles : 0.0);
+}
+
+// run times only mean something when the tasks pass time with Sim_Wait,
+// see the cycle counts in sim.h
+static void Sched_Print(const sched_task* tasks, uint8_t cycles) {
+    const sched_stats* st;
+    uint8_t i;
+    for(i = 0; (st = Sched_Report(i)); i++)
+    {
+        if(cycles) printf("task %-10s %6u runs, longest %7u cycles of %7u, %u overruns, %u missed\n", tasks[i].name,
+                          st->runs, st->max_cycles, tasks[i].budget, st->overruns, st->missed);
+        else printf("task %-10s %6u runs, %u missed\n", tasks[i].name, st->runs, st->missed);
+    }
+}
+
+static void Benchmark(void) {
+    struct timespec end;
+    double real_ms;
+    clock_gettime(CLOCK_MONOTONIC,&end);
+    real_ms = (end.tv_sec - Start.tv_sec)*1000.0 + (end.tv_nsec - Start.tv_nsec)/1e6;
+    printf("\n%u ms simulated in %.0f ms, %.1fx real-time, %llu CPU cycles\n",
+           Sim_ms, real_ms, Sim_ms/real_ms, (unsigned long long)Sim_Time());
+    printf("interrupts: TA1_0 %u  ADC14 %u  PORT4 %u  TA0_0 %u  TA0_N %u  TA2_0 %u  TA2_N %u  TA3_0 %u  TA3_N %u  DMA_INT1 %u  SysTick %u  PendSV %u\n",
+           Sim_IRQCount(10), Sim_IRQCount(24), Sim_IRQCount(38), Sim_IRQCount(8), Sim_IRQCount(9), Sim_IRQCount(12),
+           Sim_IRQCount(13), Sim_IRQCount(14), Sim_IRQCount(15), Sim_IRQCount(33), Sim_IRQCount(-1), Sim_IRQCount(-2));
+    printf("duty cycles dropped before the PWM rollover: %u at %.0f Hz\n", TimerA0_Dropped(), PWM_Freq());
+    printf("center IR noise: %.1f ADC counts rms\n", IR_Samples ? sqrt(IR_Noise/IR_Samples) : 0.0);
+    Motor_Report("left ",&Left);
+    Motor_Report("right",&Right);
+    printf("heading error from slip: %.1f degrees\n", Slip_Yaw*180/PI);
+    printf("sensor pipeline: %u PendSV runs, %u merged, %u captures skipped\n", PendSV_Report()->runs,
+           PendSV_Report()->merged, adc_skipped);
+    Nesting_Report();
+    printf("dropped on a full ring: %u samples, %u bumps, %u IR stops\n",
+           Ring_Overruns(&Sample_Ring), Ring_Overruns(&Bump_Ring), Ring_Overruns(&Estop_Ring));
+    printf("sensor snapshots: %u written, %u reads started over\n", Sensor_Lock.seq/2, Sensor_Lock.retries);
+    Sched_Print(Main_Tasks,0);
+}
+
+
+// called every ms of simulated time, moves the robot and injects the sensors
+static uint32_t End_ms;
+
+static void World(uint32_t ms) {
+    double left, right, wall, duty, ripple, err;
+    uint32_t i;
+    Sim_ms = ms;
+
+    Wheel(&Left, P3->OUT & 0x80, P5->OUT & 0x10, Duty(0x80,TA0CCR4), ms);
+    Wheel(&Right,P3->OUT & 0x40, P5->OUT & 0x20, Duty(0x40,TA0CCR3), ms);
+    Encoder(&Left,5,2);                         //P10.5, P5.2
+    Encoder(&Right,4,0);                        //P10.4, P5.0
+    Sim_SetAnalog(BATT_CHNL,(Battery - BATT_SAG*fabs(Left.drive - Left.spin)/MAX_SPEED)/BATT_DIVIDER*16384/3300);
+    if(!Quiet && (P3->OUT & 0xC0)) Battery -= BATT_DRAIN;
+    left  = Left.ground;
+    right = Right.ground;
+    Slip_Yaw += fabs((Right.spin - Left.spin) - (right - left))/WHEEL_BASE/1000;
+
+    Heading += (right - left)/WHEEL_BASE/1000;
+    X += (left + right)/2*cos(Heading)/1000;
+    Y += (left + right)/2*sin(Heading)/1000;
+    if(X < ROBOT_R) X = ROBOT_R;                //walls stop the robot
+    if(X > ROOM_W - ROBOT_R) X = ROOM_W - ROBOT_R;
+    if(Y < ROBOT_R) Y = ROBOT_R;
+    if(Y > ROOM_H - ROBOT_R) Y = ROOM_H - ROBOT_R;
+
+    //the ADC samples a random point of the PWM wave, the RC filter passes
+    //less of the ripple the further the PWM frequency is above its corner
+    duty   = ((P3->OUT & 0x80) ? Duty(0x80,TA0CCR4) : 0)/2 + ((P3->OUT & 0x40) ? Duty(0x40,TA0CCR3) : 0)/2;
+    ripple = RIPPLE_ADC*(((double)rand()/RAND_MAX < duty) - duty)/sqrt(1 + pow(PWM_Freq()/RAIL_HZ,2));
+    for(i = 0; i < ANALOG_CHNLS; i++)
+    {
+        Dist[i] = Ray(Heading + Sensor_Angle[i]);
+        if(Dist[i] < 50) Dist[i] = 50;          //sensor range
+        if(Dist[i] > 800) Dist[i] = 800;
+        Sim_SetAnalog(Sensor_Chnl[i],ConvertADC(Dist[i]) + rand()%65 - 32 + ripple);
+    }
+    if(!Quiet && ms % 10 == 5)                  //between the 10 ms samples
+    {
+        err = (double)raw_adc_vals[CENTER] - ConvertADC(Dist[CENTER]);
+        IR_Noise += err*err;
+        IR_Samples++;
+    }
+
+    wall = Ray(Heading);                        //front bump switch, P4.2
+    if(wall < 5 && !Bumped) Bumps++;
+    Bumped = (wall < 5);
+    Sim_SetPin(SIM_PORT4,2,!Bumped);
+
+    if(ms % REPORT_MS == 0 && !Quiet) Report();
+    if(ms >= End_ms)
+    {
+        Benchmark();
+        exit(0);
+    }
+}
+
+
+// stopping distance from 200 mm/s, 1/3 duty
+static void Stop_Run(const char* name, uint16_t pulseDuty, uint16_t pulseMs, uint16_t brakeMs) {
+    double x0, ms0;
+    X = ROOM_W/4; Y = ROOM_H/2; Heading = 0;
+    Motor_SetVelocity(10923,10923);
+    Clock_Delay1ms(1500);
+    x0 = X; ms0 = Sim_ms;
+    if(brakeMs || pulseMs) Motor_Brake(pulseDuty,pulseMs,brakeMs);
+    else Motor_Stop();
+    while(fabs(Left.ground) + fabs(Right.ground) > 1 && Sim_ms - ms0 < 3000) Clock_Delay1ms(1);
+    printf("%-28s %5.1f mm in %4.0f ms, peak current %3.0f%% of stall\n", name, X - x0, Sim_ms - ms0,
+           100*((Left.peak_amps > Right.peak_amps) ? Left.peak_amps : Right.peak_amps));
+    Motor_Stop();
+    Clock_Delay1ms(1000);
+}
+
+// a crash in RCR_main.c, brake then queue the back up right away,
+// it should wait out the brake instead of ending it
+static void Brake_Then_Back(void) {
+    const motion_seg back_up = {-100, -100, 1500, 130, 0};   //Back_Up in RCR_main.c
+    double x0, ms0, stop = 0, rev = -1;
+    Tach_Init();
+    Motion_Init(0);
+    X = ROOM_W/4; Y = ROOM_H/2; Heading = 0;
+    Motor_SetVelocity(10923,10923);
+    Clock_Delay1ms(1500);
+    x0 = X; ms0 = Sim_ms;
+    Motor_Brake(0,0,500);
+    Motion_Add(&back_up);
+    while(Motion_Busy() && Sim_ms - ms0 < 3000)
+    {
+        if(X - x0 > stop) stop = X - x0;
+        if(rev < 0 && Motor_Direction() == 0x30) rev = Sim_ms - ms0;
+        Clock_Delay1ms(1);
+    }
+    printf("brake 500 ms, then back up    %5.1f mm, back up starts at %4.0f ms\n", stop, rev);
+}
+
+static void Stop_Test(void) {
+    Clock_Init48MHz();
+    Motor_Init(PWM_HZ);
+    EnableInterrupts();
+    printf("stopping distance from %.0f mm/s\n", MAX_SPEED*10923/32768);
+    Left.peak_amps = Right.peak_amps = 0;
+    Stop_Run("coast (Motor_Stop)",0,0,0);
+    Left.peak_amps = Right.peak_amps = 0;
+    Stop_Run("brake 500 ms",0,0,500);
+    Left.peak_amps = Right.peak_amps = 0;
+    Stop_Run("reverse 20 ms, brake 500 ms",10923,20,500);
+    Left.peak_amps = Right.peak_amps = 0;
+    Stop_Run("reverse 50 ms, brake 500 ms",10923,50,500);
+    Brake_Then_Back();
+    exit(0);
+}
+
+
+// speed of both wheels after a step from rest, from the wheel model
+static void Speed_Run(const char* name, uint8_t closed) {
+    double l90 = -1, r90 = -1, lpeak = 0, rpeak = 0, ms0, t;
+    if(closed) Motor_SetSpeed(200,200);
+    else Motor_SetVelocity(10923,10923);        //the duty for 200 mm/s at MOTOR_NOMINAL_MV
+    ms0 = Sim_ms;
+    while((t = Sim_ms - ms0) < 1500)
+    {
+        if(l90 < 0 && Left.ground  >= 180) l90 = t;
+        if(r90 < 0 && Right.ground >= 180) r90 = t;
+        if(Left.ground  > lpeak) lpeak = Left.ground;
+        if(Right.ground > rpeak) rpeak = Right.ground;
+        Clock_Delay1ms(1);
+    }
+    printf("%-12s left %5.1f mm/s, 90%% in %4.0f ms, peak %5.1f   right %5.1f mm/s, 90%% in %4.0f ms, peak %5.1f\n",
+           name, Left.ground, l90, lpeak, Right.ground, r90, rpeak);
+    Motor_Stop();
+    Clock_Delay1ms(1000);
+}
+
+// 200 mm/s forward to 200 mm/s back, settled once both wheels stay
+// within 5% of where they end up
+static void Reverse_Run(const char* name, uint32_t accel, uint32_t jerk) {
+    static double lhist[1500], rhist[1500];
+    double lout = 0, rout = 0, lend, rend, ms0;
+    uint32_t i = 0, t;
+    Motor_SetRamp(accel,jerk);
+    Motor_SetVelocity(10923,10923);
+    Clock_Delay1ms(1500);
+    Left.peak_amps = Right.peak_amps = Left.slip = Right.slip = 0;
+    Motor_SetVelocity(-10923,-10923);
+    ms0 = Sim_ms;
+    while((t = Sim_ms - ms0) < 1500)       //the sim can pass several ms in one delay
+    {
+        for(; i <= t; i++)
+        {
+            lhist[i] = Left.ground;
+            rhist[i] = Right.ground;
+        }
+        Clock_Delay1ms(1);
+    }
+    lend = Left.ground; rend = Right.ground;
+    for(; i < 1500; i++)
+    {
+        lhist[i] = lend;
+        rhist[i] = rend;
+    }
+    for(i = 0; i < 1500; i++)
+    {
+        if(fabs(lhist[i] - lend) > 0.05*fabs(lend)) lout = i + 1;
+        if(fabs(rhist[i] - rend) > 0.05*fabs(rend)) rout = i + 1;
+    }
+    printf("%-12s settled left %4.0f ms right %4.0f ms, slipped %4.1f mm %4.1f mm, peak current %3.0f%% of stall\n",
+           name, lout, rout, Left.slip, Right.slip,
+           100*((Left.peak_amps > Right.peak_amps) ? Left.peak_amps : Right.peak_amps));
+    Motor_Stop();
+    Clock_Delay1ms(1000);
+}
+
+static void Speed_Test(void) {
+    Clock_Init48MHz();
+    Motor_Init(PWM_HZ);
+    Tach_Init();
+    EnableInterrupts();
+    printf("reverse from 200 mm/s, open loop\n");
+    Reverse_Run("no ramp",0,0);
+    Reverse_Run("ramp",65536,1310720);
+    printf("step to 200 mm/s, left motor %.0f%% as strong\n", LEFT_GAIN*100);
+    Speed_Run("open loop",0);
+    Speed_Run("speed loop",1);
+    Battery = 6600;
+    printf("open loop at %.0f mV\n", Battery);
+    Speed_Run("no comp",0);
+    Motor_SetSupply(Battery);
+    Speed_Run("compensated",0);
+    exit(0);
+}
+
+
+// back up 300 ms, pivot right 90 degrees by the encoders, forward 500 ms
+static volatile uint32_t Motion_Done_ms;
+
+static void Motion_Finished(void) {
+    Motion_Done_ms = Sim_ms;
+}
+
+static void Motion_Test(void) {
+    const motion_seg back_up = {-100, -100, 1500, 130, 0};   //Back_Up in RCR_main.c
+    const motion_seg pivot   = { 100, -100, 2000, 180, 0};
+    const motion_seg ahead   = { 150,  150,  500,   0, 0};
+    double x0 = X, y0 = Y, h0 = Heading, back = 0, d, ms0;
+    Clock_Init48MHz();
+    Motor_Init(PWM_HZ);
+    Motor_SetRamp(65536,1310720);
+    Tach_Init();
+    Motion_Init(&Motion_Finished);
+    EnableInterrupts();
+    ms0 = Sim_ms;
+    Motion_Add(&back_up);
+    Motion_Add(&pivot);
+    Motion_Add(&ahead);
+    while(!Motion_Done_ms)
+    {
+        d = -((X - x0)*cos(h0) + (Y - y0)*sin(h0));     //farthest back, the pivot turns in place
+        if(d > back) back = d;
+        Clock_Delay1ms(1);
+    }
+    printf("back up    %5.1f mm, 130 edges is 80 mm before the ramp down\n", back);
+    printf("pivot      %5.1f degrees, goal -90\n", (Heading - h0)*180/PI);
+    printf("done       callback at %u ms\n", Motion_Done_ms - (uint32_t)ms0);
+    exit(0);
+}
+
+
+// the SysID steps from RCR_main.c, logged for tools/fit_motor.c
+static const sysid_step ID_Steps[] = {
+    {    0, 200}, { 1500, 600}, { 3000, 600}, { 6000, 600},
+    {10000, 600}, {14000, 600}, {18000, 600}, {    0, 600}
+};
+
+static void SysID_Test(void) {
+    const sysid_sample* log;
+    uint16_t i, n;
+    Clock_Init48MHz();
+    Motor_Init(PWM_HZ);
+    Tach_Init();
+    EnableInterrupts();
+    SysID_Start(ID_Steps,sizeof(ID_Steps)/sizeof(ID_Steps[0]),0);
+    while(SysID_Busy()) Clock_Delay1ms(1);
+    n = SysID_Log(&log);
+    for(i = 0; i < n; i++) printf("%d %d %d\n", log[i].duty, log[i].left, log[i].right);
+    exit(0);
+}
+
+
+// every sequence gets its own values on each channel, so a task called
+// before the last MEM is latched sees one left over from the sequence
+// before and counts as torn
+#define ADC_SEQS    1000
+
+static const adc_chnl_desc ADC_Test_Chnls[] = {
+    {17, 9, 0, 2, ADC_SHT_96}, {14, 6, 1, 0, ADC_SHT_96},      //out of index order on purpose
+    {16, 9, 1, 3, ADC_SHT_96}, {BATT_CHNL, 6, 0, 1, ADC_SHT_96}
+};
+
+#define ADC_TEST_CHNLS (sizeof(ADC_Test_Chnls)/sizeof(ADC_Test_Chnls[0]))
+
+static uint32_t ADC_Test_Vals[ADC_TEST_CHNLS];
+static volatile uint32_t ADC_Seq, ADC_Calls, ADC_Torn, ADC_Busy;
+
+static void ADC_Test_Task(void) {
+    uint32_t i;
+    ADC_Calls++;
+    if(ADC14->CTL0 & 0x00010000) ADC_Busy++;        //still converting
+    for(i = 0; i < ADC_TEST_CHNLS; i++)
+    {
+        if(ADC_Test_Vals[ADC_Test_Chnls[i].index] != 1000*i + ADC_Seq % 1000)
+        {
+            ADC_Torn++;
+            break;
+        }
+    }
+}
+
+static void ADC_Test(void) {
+    uint32_t i, calls;
+    Clock_Init48MHz();
+    ADC0_InitTask(ADC_Test_Chnls,ADC_TEST_CHNLS,ADC_Test_Vals,&ADC_Test_Task);
+    EnableInterrupts();
+    for(ADC_Seq = 1; ADC_Seq <= ADC_SEQS; ADC_Seq++)
+    {
+        for(i = 0; i < ADC_TEST_CHNLS; i++) Sim_SetAnalog(ADC_Test_Chnls[i].anlg_chnl,1000*i + ADC_Seq % 1000);
+        calls = ADC_Calls;
+        ADC_Start();
+        for(i = 0; i < 100 && ADC_Calls == calls; i++) Sim_Wait(480);   //10 us at a time, up to 1 ms
+    }
+    printf("%u sequences of %u channels, task called %u times, %u torn, %u while busy\n",
+           ADC_SEQS, (unsigned)ADC_TEST_CHNLS, ADC_Calls, ADC_Torn, ADC_Busy);
+    printf("%s\n", (ADC_Calls == ADC_SEQS && !ADC_Torn && !ADC_Busy) ? "PASS" : "FAIL");
+    exit((ADC_Calls == ADC_SEQS && !ADC_Torn && !ADC_Busy) ? 0 : 1);
+}
+
+
+// made up tasks on a 10 ms virtual tick, the slow one runs past its
+// budget every time and delays the tasks queued behind it
+static void Fast_Task(void)  { Sim_Wait(4800); }         //100 us
+static void Slow_Task(void)  { Sim_Wait(1200000); }      //25 ms, 2 ticks go by
+static void Log_Task(void)   { Sim_Wait(48000); }        //1 ms
+
+static const sched_task Test_Tasks[] = {
+    {"fast",  &Fast_Task,  1,  0, 0,   9600},
+    {"log",   &Log_Task,   5,  2, 2,  96000},
+    {"slow",  &Slow_Task, 20, 10, 1, 960000}
+};
+
+static void Sched_Test(void) {
+    uint64_t next;
+    Clock_Init48MHz();
+    SysTick_Init();
+    Sched_Init(Test_Tasks,sizeof(Test_Tasks)/sizeof(Test_Tasks[0]));
+    next = Sim_Time();
+    while(Sched_Ticks() < 1000)                 //10 s of virtual ticks, no timer interrupt
+    {
+        if(Sim_Time() >= next)
+        {
+            Sched_Tick();                       //catches up after a task ran past a tick
+            next += 480000;
+        }
+        else if(!Sched_Run()) Sim_Wait(next - Sim_Time());
+    }
+    printf("%u ticks, %u overruns and missed releases\n", Sched_Ticks(), Sched_Overruns());
+    Sched_Print(Test_Tasks,1);
+    exit(0);
+}
+
+
+int main(int argc, char** argv) {
+    if(argc > 1 && !strcmp(argv[1],"stop"))
+    {
+        End_ms = 0xFFFFFFFF;
+        Quiet  = 1;
+        Sim_Init(&World,100);
+        Stop_Test();
+    }
+    if(argc > 1 && !strcmp(argv[1],"speed"))
+    {
+        End_ms = 0xFFFFFFFF;
+        Quiet  = 1;
+        Sim_Init(&World,100);
+        Speed_Test();
+    }
+    if(argc > 1 && !strcmp(argv[1],"motion"))
+    {
+        End_ms = 0xFFFFFFFF;
+        Quiet  = 1;
+        Sim_Init(&World,100);
+        Motion_Test();
+    }
+    if(argc > 1 && !strcmp(argv[1],"sysid"))
+    {
+        End_ms = 0xFFFFFFFF;
+        Quiet  = 1;
+        Sim_Init(&World,100);
+        SysID_Test();
+    }
+    if(argc > 1 && !strcmp(argv[1],"adc"))
+    {
+        End_ms = 0xFFFFFFFF;
+        Quiet  = 1;
+        Sim_Init(0,100);
+        ADC_Test();
+    }
+    if(argc > 1 && !strcmp(argv[1],"sched"))
+    {
+        End_ms = 0xFFFFFFFF;
+        Quiet  = 1;
+        Sim_Init(0,100);
+        Sched_Test();
+    }
+    End_ms = (argc > 1) ? atoi(argv[1]) : 10000;
+    Battery = BATT_START;
+    clock_gettime(CLOCK_MONOTONIC,&Start);
+    Sim_Init(&World,(argc > 2) ? atoi(argv[2]) : 20);
+    World(0);
+    Firmware_Main();
+    return 0;
+}
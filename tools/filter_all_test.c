@@ -0,0 +1,106 @@
+// filter_all_test.c
+// Host tool, not part of the MSP432 build
+// Abhi Kallur
+
+// Checks that LowPassFilter_All from RCR_IRDistance.c
+// gives bit-exact the same results as LowPassFilter
+// called for each channel in order. Each pattern is run
+// once through LowPassFilter_All and once one channel at
+// a time from the same start, and every output compared.
+// Patterns are random samples over the full 14-bit range,
+// every channel saturated high then low, and channels of
+// a packed pair swinging full scale in opposite directions,
+// so one 16-bit lane has the largest positive change while
+// the other has the largest negative one and a borrow
+// leaking between them shows up. Each runs many times
+// around the FILTER_SIZE buffer, with every filter setup
+// that takes the packed path and one that falls back.
+//
+// Build and run from the project folder:
+//   gcc -O2 -I. -o filter_all_test tools/filter_all_test.c RCR_IRDistance.c
+//   ./filter_all_test
+//
+// Prints PASS or the first difference, and exits with 1 on
+// a difference.
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include "RCR_IRDistance.h"
+
+#define ADC_MAX     16383
+#define RUN_LEN     (FILTER_SIZE*40)    //samples per pattern, wraps the buffer index 20 times
+
+static uint32_t rand_state = 12345;
+
+static uint32_t Rand_ADC(void) {
+    rand_state = rand_state*1664525 + 1013904223;
+    return (rand_state >> 8) % (ADC_MAX+1);
+}
+
+// sample n of a pattern on a channel
+static uint32_t Pattern(uint32_t pattern, uint32_t n, uint32_t chnl) {
+    switch(pattern)
+    {
+        case 0:  return Rand_ADC();
+        case 1:  return ((n/FILTER_SIZE) & 1) ? 0 : ADC_MAX;                //all channels high, then low
+        default: return ((n + chnl) & 1) ? 0 : ADC_MAX;                    //neighbors opposite every sample
+    }
+}
+
+static const char* Pattern_Name[] = {"random", "saturating", "opposite lanes"};
+
+static const filter_config Setups[][FILTER_CHNLS] = {
+    {{FILTER_BOXCAR, 0, 0},  {FILTER_BOXCAR, 0, 0},  {FILTER_BOXCAR, 0, 0}},
+    {{FILTER_BOXCAR, 0, 5},  {FILTER_BOXCAR, 0, 3},  {FILTER_BOXCAR, 0, 7}},    //medians in front
+    {{FILTER_BOXCAR, 0, 0},  {FILTER_EMA, 8192, 0},  {FILTER_BIQUAD, 4096, 3}}  //pair falls back
+};
+
+#define SETUPS (sizeof(Setups)/sizeof(Setups[0]))
+
+static uint32_t In[RUN_LEN][FILTER_CHNLS];
+static uint32_t Out[RUN_LEN][FILTER_CHNLS];
+
+int main(void) {
+    uint32_t init[FILTER_CHNLS], buf[FILTER_CHNLS];
+    uint32_t s, p, n, c, y, runs = 0;
+
+    for(s = 0; s < SETUPS; s++)
+    {
+        for(p = 0; p < 3; p++)
+        {
+            for(c = 0; c < FILTER_CHNLS; c++) init[c] = (p == 2) ? (c & 1)*ADC_MAX : Rand_ADC();
+            for(n = 0; n < RUN_LEN; n++)
+            {
+                for(c = 0; c < FILTER_CHNLS; c++) In[n][c] = Pattern(p,n,c);
+            }
+
+            LowPassFilter_Init(init,Setups[s]);
+            for(n = 0; n < RUN_LEN; n++)
+            {
+                for(c = 0; c < FILTER_CHNLS; c++) buf[c] = In[n][c];
+                LowPassFilter_All(buf,buf);         //in place, like Process_ADC_Samples
+                for(c = 0; c < FILTER_CHNLS; c++) Out[n][c] = buf[c];
+            }
+
+            LowPassFilter_Init(init,Setups[s]);
+            for(n = 0; n < RUN_LEN; n++)
+            {
+                for(c = 0; c < FILTER_CHNLS; c++)
+                {
+                    y = LowPassFilter(c,In[n][c]);
+                    if(y != Out[n][c])
+                    {
+                        printf("FAIL: setup %u, %s, sample %u, channel %u: LowPassFilter_All %u, LowPassFilter %u\n",
+                               s, Pattern_Name[p], n, c, Out[n][c], y);
+                        return 1;
+                    }
+                }
+            }
+            runs++;
+        }
+    }
+    printf("%u patterns of %u samples on %d channels, all bit-exact\n", runs, RUN_LEN, FILTER_CHNLS);
+    printf("PASS\n");
+    return 0;
+}
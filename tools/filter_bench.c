@@ -0,0 +1,112 @@
+// filter_bench.c
+// Host tool, not part of the MSP432 build
+// Abhi Kallur
+
+// Times the boxcar filter and ConvertDist from
+// RCR_IRDistance.c on the host against the versions
+// they replaced, the boxcar with % and / by a filter
+// size picked at run time and ConvertDist doing the
+// calibration equation in double precision. Also
+// prints the worst difference of the distance table
+// from the equation.
+//
+// Build and run from the project folder:
+//   gcc -O2 -I. -o filter_bench tools/filter_bench.c RCR_IRDistance.c -lm
+//   ./filter_bench
+//
+// These are host ns, not MSP432 cycles. The host has a
+// hardware double divide and a fast integer divide, so the
+// old versions cost far less here than on the Cortex-M4F,
+// where the double math is a software library call. Treat
+// the ratios as a lower bound on the target savings.
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "RCR_IRDistance.h"
+
+#define ADC_MAX     16383
+#define SAMPLES     4096            //random inputs, cycled through
+#define ROUNDS      4000            //passes over them for each timing
+
+static uint32_t Inputs[SAMPLES];
+static volatile uint32_t Sink;      //keeps the compiler from dropping the loops
+static volatile uint32_t Old_Size = FILTER_SIZE;    //a run time size like the malloc version
+
+
+// the boxcar filter before the bank was static, one channel
+static uint16_t Old_Buff[FILTER_SIZE];
+static uint32_t Old_Sum, Old_Cnt;
+
+static uint32_t Old_Filter(uint32_t data) {
+    uint32_t filter_size = Old_Size;
+    Old_Sum += 2*data;
+    Old_Sum -= Old_Buff[Old_Cnt];
+    Old_Sum -= Old_Buff[(Old_Cnt+1)%filter_size];
+    Old_Buff[Old_Cnt] = data;
+    Old_Buff[(Old_Cnt+1)%filter_size] = data;
+    Old_Cnt = (Old_Cnt+2)%filter_size;
+    return Old_Sum/filter_size;
+}
+
+// ConvertDist before the table
+static uint32_t Old_Dist(uint32_t ADCval) {
+    return ((INV_SLOPE/(ADCval + INTERCEPT)) - CAL_CONST)*CM_TO_MM;
+}
+
+static double Now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    return t.tv_sec*1e9 + t.tv_nsec;
+}
+
+// ns per call of a one-argument function over the random inputs
+static double Time(uint32_t (*f)(uint32_t)) {
+    uint32_t r, i, sum = 0;
+    double start = Now_ns();
+    for(r = 0; r < ROUNDS; r++)
+    {
+        for(i = 0; i < SAMPLES; i++) sum += (*f)(Inputs[i]);
+    }
+    Sink = sum;
+    return (Now_ns() - start)/((double)ROUNDS*SAMPLES);
+}
+
+static uint32_t New_Filter(uint32_t data) {
+    return LowPassFilter(0,data);
+}
+
+int main(void) {
+    const filter_config box[FILTER_CHNLS] = {{FILTER_BOXCAR, 0, 0}};
+    uint32_t init[FILTER_CHNLS] = {0};
+    uint32_t i, state = 12345, err, max_err = 0, max_at = 0, useful_err = 0, dist;
+    double t_old, t_new;
+
+    for(i = 0; i < SAMPLES; i++)
+    {
+        state = state*1664525 + 1013904223;
+        Inputs[i] = (state >> 8) % (ADC_MAX+1);
+    }
+    LowPassFilter_Init(init,box);
+
+    printf("host ns per sample, not MSP432 cycles\n");
+    t_old = Time(&Old_Filter);
+    t_new = Time(&New_Filter);
+    printf("boxcar %d, %% and /      %6.2f ns\n", FILTER_SIZE, t_old);
+    printf("boxcar %d, mask and >>   %6.2f ns   %.2fx\n", FILTER_SIZE, t_new, t_old/t_new);
+    t_old = Time(&Old_Dist);
+    t_new = Time(&ConvertDist);
+    printf("ConvertDist equation     %6.2f ns\n", t_old);
+    printf("ConvertDist table        %6.2f ns   %.2fx\n", t_new, t_old/t_new);
+
+    for(i = 0; i <= ADC_MAX; i++)           //table against the equation over every input
+    {
+        dist = Old_Dist(i);
+        err  = (ConvertDist(i) > dist) ? ConvertDist(i) - dist : dist - ConvertDist(i);
+        if(err > max_err) { max_err = err; max_at = i; }
+        if(dist >= 100 && dist <= 800 && err > useful_err) useful_err = err;
+    }
+    printf("table error: max %u mm at ADC value %u, max %u mm over 100-800 mm\n", max_err, max_at, useful_err);
+    return 0;
+}
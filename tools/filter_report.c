@@ -0,0 +1,109 @@
+// filter_report.c
+// Host tool, not part of the MSP432 build
+// Abhi Kallur
+
+// Runs each Low Pass Filter setting from RCR_IRDistance.c
+// on the host and prints its delay and how much it reduces
+// noise, so lag can be traded against smoothness before
+// picking filter_config values for RCR_main.c.
+//
+// Build and run from the project folder:
+//   gcc -O2 -I. -o filter_report tools/filter_report.c RCR_IRDistance.c -lm
+//   ./filter_report
+//
+// Group delay is the center of mass of the step response's
+// derivative, in samples and in ms at the 10 ms sample period.
+// Rise time is samples from 10% to 90% of a step. Noise
+// attenuation is output/input standard deviation for white
+// noise, in dB. Spike is the largest error in ADC counts when
+// a steady signal has a single-sample spike of SPIKE_SIZE
+// every SPIKE_RATE samples, like the Sharp sensors give.
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include "RCR_IRDistance.h"
+
+#define SAMPLE_MS   10
+#define STEP_LEN    400
+#define NOISE_LEN   20000
+#define NOISE_MEAN  8000
+#define NOISE_STD   400.0
+#define SPIKE_SIZE  6000
+#define SPIKE_RATE  20
+
+static uint32_t rand_state = 12345;
+
+// gaussian noise from a fixed seed so every run prints the same numbers
+static double Rand_Gauss(void) {
+    double u1, u2;
+    rand_state = rand_state*1664525 + 1013904223;
+    u1 = ((rand_state >> 8) + 1.0)/16777217.0;
+    rand_state = rand_state*1664525 + 1013904223;
+    u2 = (rand_state >> 8)/16777216.0;
+    return sqrt(-2.0*log(u1))*cos(2.0*M_PI*u2);
+}
+
+static void Report(const char* name, filter_config config) {
+    filter_config configs[FILTER_CHNLS];
+    uint32_t init[FILTER_CHNLS] = {0};
+    uint32_t i, y, last = 0, t10 = 0, t90 = 0, spike = 0;
+    double moment = 0, total = 0, sum = 0, sum_sq = 0, x, std, delay;
+
+    for(i = 0; i < FILTER_CHNLS; i++) configs[i] = config;
+
+    LowPassFilter_Init(init,configs);           //step from 0 to 16000
+    for(i = 0; i < STEP_LEN; i++) {
+        y = LowPassFilter(0,16000);
+        moment += (double)i*((double)y - last);
+        total  += (double)y - last;
+        if(t10 == 0 && y >= 1600)  t10 = i+1;
+        if(t90 == 0 && y >= 14400) t90 = i+1;
+        last = y;
+    }
+    delay = moment/total;
+
+    init[0] = NOISE_MEAN;
+    LowPassFilter_Init(init,configs);
+    for(i = 0; i < NOISE_LEN; i++) {
+        x = NOISE_MEAN + NOISE_STD*Rand_Gauss();
+        y = LowPassFilter(0,(uint32_t)(x + 0.5));
+        if(i < STEP_LEN) continue;              //let the filter settle
+        sum    += y;
+        sum_sq += (double)y*y;
+    }
+    i = NOISE_LEN - STEP_LEN;
+    std = sqrt(sum_sq/i - (sum/i)*(sum/i));
+
+    LowPassFilter_Init(init,configs);           //steady signal with spikes
+    for(i = 1; i <= STEP_LEN; i++) {
+        y = LowPassFilter(0,(i%SPIKE_RATE) ? NOISE_MEAN : NOISE_MEAN+SPIKE_SIZE);
+        if(y - NOISE_MEAN > spike) spike = y - NOISE_MEAN;
+    }
+
+    printf("%-14s %6u %4u  %8.1f %8.0f  %6u %8.1f %6u\n", name, config.alpha, config.median_size,
+           delay, delay*SAMPLE_MS, t90 - t10, 20.0*log10(std/NOISE_STD), spike);
+}
+
+int main(void) {
+    const uint16_t alphas[] = {16384, 8192, 4096, 2048, 1024};
+    char name[32];
+    uint32_t i;
+
+    printf("filter          alpha  med  delay(n) delay(ms) rise(n) noise(dB) spike\n");
+    sprintf(name, "boxcar %d", FILTER_SIZE);
+    Report(name, (filter_config){FILTER_BOXCAR, 0, 0});
+    for(i = 0; i < sizeof(alphas)/sizeof(alphas[0]); i++) {
+        Report("ema", (filter_config){FILTER_EMA, alphas[i], 0});
+    }
+    for(i = 0; i < sizeof(alphas)/sizeof(alphas[0]); i++) {
+        Report("biquad", (filter_config){FILTER_BIQUAD, alphas[i], 0});
+    }
+    for(i = 3; i <= MEDIAN_MAX_SIZE; i += 4) {  //median prefilter in front of the shorter filters
+        sprintf(name, "boxcar %d", FILTER_SIZE);
+        Report(name, (filter_config){FILTER_BOXCAR, 0, i});
+        Report("biquad", (filter_config){FILTER_BIQUAD, 8192, i});
+    }
+    return 0;
+}
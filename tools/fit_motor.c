@@ -0,0 +1,212 @@
+// fit_motor.c
+// Host tool, not part of the MSP432 build
+// Abhi Kallur
+
+// Fits each wheel's motor to a RCR_SysID.c capture and
+// generates RCR_MotorID.h, the constants the speed loop in
+// RCR_Motor.c uses, and reports how well the fit matches.
+//
+// Build and run from the project folder:
+//   gcc -O2 -o fit_motor tools/fit_motor.c -lm
+//   ./robot_sim sysid > capture.txt
+//   ./fit_motor capture.txt > RCR_MotorID.h
+//
+// The capture is the SysID log as duty, left and right
+// numbers, SYSID_HZ samples apart. Decimal or 0x hex both
+// work, so a 16-bit TI data file saved from the SysID_Buffer
+// address in the debugger's memory browser reads the same
+// as the simulator's output. With no file it reads stdin.
+//
+// Each wheel is fitted as a first order lag behind a
+// deadband: speed = GAIN*(duty - DEADBAND)/32768 once it
+// settles, reached with time constant TAU. GAIN and DEADBAND
+// are a line through the settled speed of every step that
+// moved the wheel. TAU is a line through the log of how far
+// each step's response still has to go, between 15% and 90%
+// of the way, so the start of the response and the noise at
+// the end don't count. The report is printed to stderr so it
+// doesn't end up in the header.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "../RCR_SysID.h"
+
+#define MAX_SAMPLES  65536
+#define SETTLED      4          //last 1/SETTLED of a step is taken as settled
+#define MIN_STEP     20.0       //mm/s, smaller steps are too noisy to time
+
+struct Wheel_Fit {
+    double gain;                //mm/s at full duty past the deadband
+    double deadband;            //Q15 duty
+    double tau;                 //ms
+    double delay;               //ms before the lag starts, mostly the tachometer
+    double rms;                 //mm/s, model against the capture
+    int    steps;               //steps the time constant was fitted on
+};
+typedef struct Wheel_Fit wheel_fit;
+
+static int16_t Duty[MAX_SAMPLES], Left[MAX_SAMPLES], Right[MAX_SAMPLES];
+
+
+// reads the capture, skipping the header line of a TI data file
+static int Read_Capture(FILE* in) {
+    char line[256], *p, *end;
+    int n = 0, field = 0, first = 1;
+    int16_t value;
+    while(fgets(line,sizeof(line),in)) {
+        if(first && !strncmp(line,"1651",4)) { first = 0; continue; }
+        first = 0;
+        for(p = line; ; p = end) {
+            value = (int16_t)strtol(p,&end,0);
+            if(end == p) break;
+            if(field == 0) Duty[n] = value;
+            if(field == 1) Left[n] = value;
+            if(field == 2) Right[n++] = value;
+            field = (field + 1) % 3;
+            if(n == MAX_SAMPLES) return n;
+        }
+    }
+    return n;
+}
+
+// mean of the settled end of the step from a to b
+static double Settled(const int16_t* speed, int a, int b) {
+    double sum = 0;
+    int i, from = b - (b - a)/SETTLED;
+    if(from == b) from = b - 1;
+    for(i = from; i < b; i++) sum += speed[i];
+    return sum/(b - from);
+}
+
+// speed the fitted model settles to at a duty
+static double Model_Speed(const wheel_fit* fit, double duty) {
+    double over = fabs(duty) - fit->deadband;
+    if(over <= 0) return 0;
+    return ((duty < 0) ? -1 : 1)*fit->gain*over/32768;
+}
+
+static void Fit(const char* name, const int16_t* speed, int n, wheel_fit* fit) {
+    double ms = 1000.0/SYSID_HZ;
+    double sx = 0, sy = 0, sxx = 0, sxy = 0, top = 0, y0, yss, r, y, err = 0;
+    double tau_sum = 0, delay_sum = 0, weight = 0, tx, ty, txx, txy, slope;
+    int a, b, i, points = 0, count;
+
+    fit->steps = 0;
+    for(a = 0; a < n; a = b) {          //largest settled speed, to judge which steps moved
+        for(b = a; b < n && Duty[b] == Duty[a]; b++);
+        yss = fabs(Settled(speed,a,b));
+        if(yss > top) top = yss;
+    }
+    for(a = 0; a < n; a = b) {          //settled speed against duty
+        for(b = a; b < n && Duty[b] == Duty[a]; b++);
+        yss = fabs(Settled(speed,a,b));
+        if(Duty[a] == 0 || yss < 0.05*top) continue;
+        sx  += abs(Duty[a]);
+        sy  += yss;
+        sxx += (double)Duty[a]*Duty[a];
+        sxy += abs(Duty[a])*yss;
+        points++;
+    }
+    if(points >= 2 && points*sxx - sx*sx > 0) {
+        slope = (points*sxy - sx*sy)/(points*sxx - sx*sx);
+        fit->gain     = slope*32768;
+        fit->deadband = (sx - sy/slope)/points;
+    }
+    else {
+        fit->gain     = points ? sy/sx*32768 : 0;
+        fit->deadband = 0;
+    }
+    if(fit->deadband < 0) fit->deadband = 0;
+
+    y0 = speed[0];
+    for(a = 0; a < n; a = b) {          //time constant of each step big enough to time
+        for(b = a; b < n && Duty[b] == Duty[a]; b++);
+        yss = Settled(speed,a,b);
+        tx = ty = txx = txy = 0;
+        count = 0;
+        for(i = a; fabs(yss - y0) >= MIN_STEP && i < b; i++) {
+            r = (yss - speed[i])/(yss - y0);
+            if(r > 0.85 || r < 0.10) continue;
+            tx  += (i - a)*ms;
+            ty  += log(r);
+            txx += (i - a)*ms*(i - a)*ms;
+            txy += (i - a)*ms*log(r);
+            count++;
+        }
+        if(count >= 5 && count*txx - tx*tx > 0) {
+            slope = (count*txy - tx*ty)/(count*txx - tx*tx);
+            if(slope < 0) {
+                tau_sum   += fabs(yss - y0)*-1/slope;
+                delay_sum += fabs(yss - y0)*(ty - slope*tx)/count/-slope;
+                weight    += fabs(yss - y0);
+                fit->steps++;
+            }
+        }
+        y0 = yss;
+    }
+    fit->tau   = weight ? tau_sum/weight : 0;
+    fit->delay = weight ? delay_sum/weight : 0;
+
+    y = speed[0];                       //run the model over the capture
+    for(i = 0; i < n; i++) {
+        if(fit->tau > 0) y += (Model_Speed(fit,Duty[i]) - y)*(1 - exp(-ms/fit->tau));
+        else y = Model_Speed(fit,Duty[i]);
+        err += (y - speed[i])*(y - speed[i]);
+    }
+    fit->rms = n ? sqrt(err/n) : 0;
+
+    fprintf(stderr, "%s wheel: %4.0f mm/s at full duty, deadband %5.0f (%4.1f%%), tau %5.1f ms from %d steps, delay %4.1f ms, model error %4.1f mm/s rms\n",
+            name, fit->gain, fit->deadband, fit->deadband*100/32768, fit->tau, fit->steps, fit->delay, fit->rms);
+}
+
+static void Define(const char* wheel, const char* name, double value, const char* comment) {
+    char full[64];
+    snprintf(full, sizeof(full), "MOTOR_%s_%s", wheel, name);
+    printf("#define %-20s %5.0f     //%s\n", full, value, comment);
+}
+
+
+int main(int argc, char** argv) {
+    FILE* in = stdin;
+    wheel_fit left, right;
+    int n;
+
+    if(argc > 1 && !(in = fopen(argv[1],"r"))) {
+        fprintf(stderr, "can't open %s\n", argv[1]);
+        return 1;
+    }
+    n = Read_Capture(in);
+    if(n < 10) {
+        fprintf(stderr, "need a capture of duty, left, right samples, got %d\n", n);
+        return 1;
+    }
+    fprintf(stderr, "%d samples, %.0f ms\n", n, n*1000.0/SYSID_HZ);
+    Fit("left ",Left,n,&left);
+    Fit("right",Right,n,&right);
+    if(left.gain <= 0 || right.gain <= 0 || left.tau <= 0 || right.tau <= 0) {
+        fprintf(stderr, "a wheel never moved enough to fit, check the steps\n");
+        return 1;
+    }
+
+    printf("// RCR_MotorID.h\n");
+    printf("// Compatible with MSP432\n");
+    printf("// Generated by tools/fit_motor.c, do not edit\n\n");
+    printf("// Motor constants fitted from a %d sample RCR_SysID.c\n", n);
+    printf("// capture. Each wheel settles to\n");
+    printf("//   GAIN*(duty - DEADBAND)/32768 mm/s\n");
+    printf("// with time constant TAU_MS once the duty steps.\n");
+    printf("// Model error: left %.1f mm/s rms, right %.1f mm/s rms\n\n", left.rms, right.rms);
+    printf("#ifndef RCR_MOTORID_H_\n#define RCR_MOTORID_H_\n\n");
+    Define("LEFT","GAIN",left.gain,"mm/s at full duty past the deadband");
+    Define("LEFT","DEADBAND",left.deadband,"Q15 duty before the wheel turns");
+    Define("LEFT","TAU_MS",left.tau,"time constant in ms");
+    Define("RIGHT","GAIN",right.gain,"mm/s at full duty past the deadband");
+    Define("RIGHT","DEADBAND",right.deadband,"Q15 duty before the wheel turns");
+    Define("RIGHT","TAU_MS",right.tau,"time constant in ms");
+    printf("\n#endif /* RCR_MOTORID_H_ */\n");
+    return 0;
+}
@@ -0,0 +1,89 @@
+// gen_dist_table.c
+// Host tool, not part of the MSP432 build
+// Abhi Kallur
+
+// Generates RCR_DistTable.h, the lookup table ConvertDist
+// uses instead of the floating point calibration equation,
+// and reports how far the table is from the equation.
+//
+// Build and run from the project folder:
+//   gcc -O2 -o gen_dist_table tools/gen_dist_table.c
+//   ./gen_dist_table 256 > RCR_DistTable.h
+//
+// The argument is the number of table segments and must be a
+// power of 2 from 1 to 16384. 16384 gives a full-size table with
+// an entry for every ADC value. Fewer segments use less flash and
+// ConvertDist interpolates between entries. The error report is
+// printed to stderr so it doesn't end up in the header.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "../RCR_IRDistance.h"
+
+#define ADC_MAX    16383      //14-bit ADC
+#define FRAC_BITS  4          //entries are stored in 1/16 mm
+
+
+// same equation and truncation as the original ConvertDist
+static uint32_t Formula_Dist(uint32_t ADCval) {
+    return ((INV_SLOPE/(ADCval + INTERCEPT)) - CAL_CONST)*CM_TO_MM;
+}
+
+// same math as ConvertDist, but on the table being generated
+static uint32_t Table_Dist(const uint16_t* table, uint32_t shift, uint32_t ADCval) {
+    uint32_t seg  = ADCval >> shift;
+    uint32_t frac = ADCval & ((1 << shift)-1);
+    return (table[seg]*((1 << shift)-frac) + table[seg+1]*frac) >> (shift + FRAC_BITS);
+}
+
+int main(int argc, char** argv) {
+    uint32_t segs = 256, shift = 0, i, dist;
+    uint16_t* table;
+    int32_t err, max_err = 0, max_err_at = 0, useful_err = 0;
+    double exact;
+
+    if(argc > 1) segs = atoi(argv[1]);
+    if(segs == 0 || segs > ADC_MAX+1 || (segs & (segs-1))) {
+        fprintf(stderr, "segments must be a power of 2 from 1 to %d\n", ADC_MAX+1);
+        return 1;
+    }
+    while((segs << shift) < ADC_MAX+1) shift++;
+
+    table = malloc((segs+1)*sizeof(uint16_t));
+    for(i = 0; i <= segs; i++) {        //one more entry than segments for the end of the last one
+        exact = ((INV_SLOPE/((i << shift) + INTERCEPT)) - CAL_CONST)*CM_TO_MM;
+        table[i] = (uint16_t)(exact*(1 << FRAC_BITS) + 0.5);
+    }
+
+    for(i = 0; i <= ADC_MAX; i++) {     //compare against the equation over the whole range
+        dist = Formula_Dist(i);
+        err  = (int32_t)Table_Dist(table,shift,i) - (int32_t)dist;
+        if(err < 0) err = -err;
+        if(err > max_err) { max_err = err; max_err_at = i; }
+        if(dist >= 100 && dist <= 800 && err > useful_err) useful_err = err;
+    }
+    fprintf(stderr, "segments: %u, entries: %u, flash: %u bytes\n", segs, segs+1, (segs+1)*2);
+    fprintf(stderr, "max error 0-%d: %d mm at ADC value %d\n", ADC_MAX, max_err, max_err_at);
+    fprintf(stderr, "max error over 100-800 mm: %d mm\n", useful_err);
+
+    printf("// RCR_DistTable.h\n");
+    printf("// Compatible with MSP432\n");
+    printf("// Generated by tools/gen_dist_table.c, do not edit\n\n");
+    printf("// Distance lookup table for ConvertDist made from the\n");
+    printf("// calibration equation in RCR_IRDistance.h. Entries are in\n");
+    printf("// 1/%d mm at every %u ADC counts.\n", 1 << FRAC_BITS, 1 << shift);
+    printf("// Max error: %d mm over 0-%d, %d mm over 100-800 mm\n\n", max_err, ADC_MAX, useful_err);
+    printf("#ifndef RCR_DISTTABLE_H_\n#define RCR_DISTTABLE_H_\n\n");
+    printf("#define DIST_TABLE_SHIFT %u      //ADC value >> shift gives segment\n", shift);
+    printf("#define DIST_TABLE_FRAC  %d      //fraction bits in entries\n\n", FRAC_BITS);
+    printf("static const uint16_t Dist_Table[%u] = {", segs+1);
+    for(i = 0; i <= segs; i++) {
+        if(i%10 == 0) printf("\n   ");
+        printf(" %5u%s", table[i], i < segs ? "," : "");
+    }
+    printf("\n};\n\n#endif /* RCR_DISTTABLE_H_ */\n");
+    free(table);
+    return 0;
+}
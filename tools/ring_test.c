@@ -0,0 +1,117 @@
+// ring_test.c
+// Host tool, not part of the MSP432 build
+// Abhi Kallur
+
+// Checks RCR_Ring.c with a real producer and consumer
+// thread running at the same time, on different cores
+// when there are some, which is harder on it than an
+// ISR and the main loop on the LaunchPad. The producer
+// puts numbered records, mostly waiting for room but
+// now and then into a full ring so some are dropped.
+// The consumer checks that every
+// record it gets is whole, in order, and that the
+// numbers it never got add up to the overrun count.
+//
+// Build and run from the project folder:
+//   gcc -O2 -Ihost -I. -pthread -o ring_test tools/ring_test.c RCR_Ring.c
+//   ./ring_test
+//
+// Prints PASS or the first problem, and exits with 1 on
+// a problem.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+#include "RCR_Ring.h"
+
+#define RECORDS     2000000     //put by the producer
+#define RING_SIZE   16          //small so it fills often
+#define WORDS       8           //record size, big enough for a copy to be caught halfway
+#define DROP_RATE   7           //every 7th record doesn't wait for room
+
+struct Test_Rec {
+    uint32_t seq;
+    uint32_t check[WORDS-1];    //all made from seq, so a torn record doesn't match
+};
+
+static struct Test_Rec Buf[RING_SIZE];
+static ring Test_Ring;
+static volatile bool Done;
+
+
+static void Fill(struct Test_Rec* rec, uint32_t seq) {
+    uint32_t i;
+    rec->seq = seq;
+    for(i = 0; i < WORDS-1; i++) rec->check[i] = seq*2654435761u + i;
+}
+
+static bool Whole(const struct Test_Rec* rec) {
+    uint32_t i;
+    for(i = 0; i < WORDS-1; i++)
+    {
+        if(rec->check[i] != rec->seq*2654435761u + i) return false;
+    }
+    return true;
+}
+
+static void* Producer(void* arg) {
+    struct Test_Rec rec;
+    uint32_t seq;
+    (void)arg;
+    for(seq = 1; seq <= RECORDS; seq++)
+    {
+        Fill(&rec,seq);
+        while(seq % DROP_RATE && Test_Ring.head - Test_Ring.tail > Test_Ring.mask) sched_yield();
+        Ring_Put(&Test_Ring,&rec);
+    }
+    Done = true;
+    return 0;
+}
+
+int main(void) {
+    pthread_t thread;
+    struct Test_Rec rec;
+    uint32_t last = 0, got = 0, skipped = 0;
+    bool done;
+
+    Ring_Init(&Test_Ring,Buf,sizeof(Buf[0]),RING_SIZE);
+    pthread_create(&thread,0,&Producer,0);
+    while(1)
+    {
+        done = Done;                    //read before the last Ring_Get so nothing is left behind
+        if(!Ring_Get(&Test_Ring,&rec))
+        {
+            if(done) break;
+            sched_yield();
+            continue;
+        }
+        if(!Whole(&rec))
+        {
+            printf("FAIL: record %u torn\n", rec.seq);
+            return 1;
+        }
+        if(rec.seq <= last)
+        {
+            printf("FAIL: record %u after %u\n", rec.seq, last);
+            return 1;
+        }
+        skipped += rec.seq - last - 1;
+        last = rec.seq;
+        got++;
+        if(got % 256 == 0) sched_yield();   //fall behind now and then so the ring fills
+    }
+    pthread_join(thread,0);
+    skipped += RECORDS - last;
+    printf("%u records, %u taken, %u dropped, %u overruns counted\n", RECORDS, got, skipped, Ring_Overruns(&Test_Ring));
+    if(skipped != Ring_Overruns(&Test_Ring) || got + skipped != RECORDS)
+    {
+        printf("FAIL: dropped records don't match the overruns\n");
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}